@@ -0,0 +1,71 @@
+#!/bin/bash
+# Benchmarks xcheck on generated images of increasing size.
+#
+# Builds xcheck and mkimage, generates one image per entry in SIZES, and times
+# each xcheck configuration in MODES on it. Results are written as CSV, one line
+# per image and mode, with the best time out of RUNS. The stages of one more run
+# of each, as timed by --stats, are written to stages.csv in the work directory.
+#
+# Usage: bench.sh [work_dir]
+#
+# Environment:
+#   SIZES   image sizes in blocks            (default "100000 1000000 4000000")
+#   FILES   files per 100 blocks             (default 1)
+#   FANOUT  directory fanout                 (default 32)
+#   LINKS   hard links per file              (default 0.1)
+#   FRAG    fragmentation, 0 to 1            (default 0.5)
+#   FSIZE   file size distribution           (default "e:8192")
+#   MODES   xcheck options, ';' separated    (default "-j 1;-j 4;-B pread")
+#   RUNS    runs per configuration           (default 3)
+
+SIZES=${SIZES:-"100000 1000000 4000000"}
+FILES=${FILES:-1}
+FANOUT=${FANOUT:-32}
+LINKS=${LINKS:-0.1}
+FRAG=${FRAG:-0.5}
+FSIZE=${FSIZE:-"e:8192"}
+MODES=${MODES:-"-j 1;-j 4;-B pread"}
+RUNS=${RUNS:-3}
+
+SRC=$(cd "$(dirname "$0")" && pwd)
+WORK=${1:-$(mktemp -d)}
+mkdir -p "$WORK"
+
+# Build the tools
+gcc -O2 -pthread -o "$WORK/xcheck" "$SRC/xcheck.c" "$SRC/libxcheck.c" || exit 1
+gcc -O2 -o "$WORK/mkimage" "$SRC/mkimage.c" -lm || exit 1
+
+echo "image,blocks,inodes,mode,seconds,inodes_per_s,blocks_per_s"
+echo "image,mode,stage,wall_ms,cpu_ms,blocks_read" > "$WORK/stages.csv"
+
+for size in $SIZES; do
+	image="$WORK/bench_$size.img"
+	files=$((size * FILES / 100))
+	"$WORK/mkimage" -b "$size" -n "$files" -d "$FANOUT" -l "$LINKS" -f "$FRAG" -z "$FSIZE" "$image" > /dev/null || exit 1
+
+	# The inode count is in the super block
+	inodes=$(od -An -tu4 -j 520 -N 4 "$image" | tr -d ' ')
+
+	IFS=';'
+	for mode in $MODES; do
+		unset IFS
+		best=""
+		for run in $(seq "$RUNS"); do
+			start=$(date +%s.%N)
+			"$WORK/xcheck" $mode "$image" > /dev/null 2>&1
+			end=$(date +%s.%N)
+			best=$(awk -v s="$start" -v e="$end" -v b="$best" 'BEGIN { t = e - s; if(b == "" || t < b) b = t; printf "%.4f", b }')
+		done
+
+		awk -v img="$(basename "$image")" -v blocks="$size" -v inodes="$inodes" -v mode="$mode" -v t="$best" \
+			'BEGIN { printf "%s,%d,%d,%s,%.4f,%.0f,%.0f\n", img, blocks, inodes, mode, t, inodes / t, blocks / t }'
+
+		# One line per stage
+		"$WORK/xcheck" $mode --stats="$WORK/stats.json" "$image" > /dev/null 2>&1
+		grep '"name"' "$WORK/stats.json" |
+			sed -E 's/.*"name": "([^"]*)", "wall_ms": ([0-9.]+), "cpu_ms": ([0-9.]+), "inodes": [0-9]+, "blocks_read": ([0-9]+).*/\1,\2,\3,\4/' |
+			sed "s|^|$(basename "$image"),$mode,|" >> "$WORK/stages.csv"
+		IFS=';'
+	done
+	unset IFS
+done
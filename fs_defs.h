@@ -6,16 +6,28 @@
 
 // Block 0 is unused.
 // Block 1 is super block.
-// Inodes start at block 2.
+// Inodes start at block 2, unless the super block places them after a log.
 
 #define ROOTINO 1  // root i-number
 #define BSIZE 512  // block size
 
-// File system super block
+// File system super block. Older images stop after ninodes, and leave the
+// rest zero.
 struct superblock {
   uint size;         // Size of file system image (blocks)
   uint nblocks;      // Number of data blocks
   uint ninodes;      // Number of inodes.
+  uint nlog;         // Number of log blocks
+  uint logstart;     // Block number of first log block
+  uint inodestart;   // Block number of first inode block
+  uint bmapstart;    // Block number of first free map block
+};
+
+// Header of the log, in its first block. The n blocks after it are committed
+// copies of the blocks listed, still to be installed.
+struct logheader {
+  int n;
+  int block[];
 };
 
 #define NDIRECT 12
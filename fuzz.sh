@@ -0,0 +1,162 @@
+#!/bin/bash
+# Fuzzes xcheck with corrupted copies of the sample images.
+#
+# Builds xcheck, then for each seed image in file_systems/ and fs.img, and for
+# images mkimage writes in the 512-double and 4k-double layouts with files large
+# enough to need their doubly indirect blocks, writes ITERS corrupted copies and
+# checks each with every configuration in MODES.
+# Most corruptions land in the super block, inode table and bitmap, and a share
+# of them set inode sizes and addresses to extreme values. An image is flagged
+# if xcheck crashes, runs past TIMEOUT seconds, or takes more than SLOW times as
+# long as its seed: the copy is the same size as its seed, so the extra time is
+# work out of proportion to the input. Flagged images are kept in the work
+# directory, and listed as CSV, one line per image and mode.
+#
+# Usage: fuzz.sh [work_dir]
+#
+# Environment:
+#   ITERS      corrupted copies per seed       (default 200)
+#   MUTATIONS  corruptions per copy, at most   (default 8)
+#   MODES      xcheck options, ';' separated   (default "--all;-j 4;-B pread;--level quick")
+#   TIMEOUT    seconds before a run is a hang  (default 10)
+#   SLOW       slowdown over the seed flagged  (default 50)
+#   SEED       random seed                     (default 1)
+#   CFLAGS     compiler flags                  (default "-O2")
+#
+# Building with -fsanitize=address,undefined also flags reads out of bounds; the
+# sanitizers are set to exit with a status of their own.
+
+ITERS=${ITERS:-200}
+MUTATIONS=${MUTATIONS:-8}
+MODES=${MODES:-"--all;-j 4;-B pread;--level quick"}
+TIMEOUT=${TIMEOUT:-10}
+SLOW=${SLOW:-50}
+SEED=${SEED:-1}
+CFLAGS=${CFLAGS:-"-O2"}
+
+SRC=$(cd "$(dirname "$0")" && pwd)
+WORK=${1:-$(mktemp -d)}
+mkdir -p "$WORK"
+
+RANDOM=$SEED
+
+export ASAN_OPTIONS=${ASAN_OPTIONS:-exitcode=86}
+export UBSAN_OPTIONS=${UBSAN_OPTIONS:-halt_on_error=1:exitcode=86}
+
+# Build the checker, and the generator for the seeds in the doubly indirect layouts
+gcc $CFLAGS -pthread -o "$WORK/xcheck" "$SRC/xcheck.c" "$SRC/libxcheck.c" || exit 1
+gcc -O2 -o "$WORK/mkimage" "$SRC/mkimage.c" -lm || exit 1
+"$WORK/mkimage" -b 2000 -i 64 -n 8 -z u:70000:120000 -g 512-double -s "$SEED" "$WORK/seed-512-double" > /dev/null || exit 1
+"$WORK/mkimage" -b 1200 -i 64 -n 1 -z u:4300000:4400000 -g 4k-double -s "$SEED" "$WORK/seed-4k-double" > /dev/null || exit 1
+
+# Values likely to find edge cases in sizes and addresses
+WORDS=(0 1 511 512 6144 6145 71680 71681 2147483647 2147483648 4294967295)
+
+# Prints a random number below $1, from up to 30 bits
+random(){
+	echo $(( ((RANDOM << 15) | RANDOM) % $1 ))
+}
+
+# Writes the 32-bit little endian word $3 at byte $2 of image $1
+putWord(){
+	printf "$(printf '\\x%02x\\x%02x\\x%02x\\x%02x' $(($3 & 255)) $(($3 >> 8 & 255)) $(($3 >> 16 & 255)) $(($3 >> 24 & 255)))" |
+		dd of="$1" bs=1 seek="$2" conv=notrunc status=none
+}
+
+# Writes the byte $3 at byte $2 of image $1
+putByte(){
+	printf "$(printf '\\x%02x' "$3")" | dd of="$1" bs=1 seek="$2" conv=notrunc status=none
+}
+
+# Corrupts image $1, whose metadata ends at block $2 and which holds $3 inodes in
+# blocks of $4 bytes
+mutate(){
+	local count=$(( $(random "$MUTATIONS") + 1 ))
+	local bytes=$(stat -c %s "$1")
+	local i
+	for i in $(seq "$count"); do
+		local word=${WORDS[$(random ${#WORDS[@]})]}
+		case $(random 4) in
+			# An inode's size, or one of its addresses
+			0) putWord "$1" $(( 2 * $4 + $(random "$3") * 64 + 8 )) "$word" ;;
+			1) putWord "$1" $(( 2 * $4 + $(random "$3") * 64 + 12 + $(random 13) * 4 )) "$word" ;;
+			# Any byte of the metadata, or of the whole image
+			2) putByte "$1" $(( $4 + $(random $(( $2 * $4 - $4 ))) )) $(random 256) ;;
+			3) putByte "$1" $(random "$bytes") $(random 256) ;;
+		esac
+	done
+}
+
+# Runs xcheck with options $1 on image $2, printing the exit status and seconds taken
+run(){
+	local start=$(date +%s.%N)
+	timeout "$TIMEOUT" "$WORK/xcheck" $1 "$2" > /dev/null 2>&1
+	local status=$?
+	local end=$(date +%s.%N)
+	echo "$status $(awk -v s="$start" -v e="$end" 'BEGIN { printf "%.4f", e - s }')"
+}
+
+echo "image,seed,mode,result,seconds,seed_seconds"
+
+flagged=0
+declare -A base
+for seed in "$SRC"/file_systems/* "$SRC/fs.img" "$WORK/seed-512-double" "$WORK/seed-4k-double"; do
+	name=$(basename "$seed")
+
+	# The block size is the one xcheck detects, and the inode count and size are
+	# in the super block
+	bsize=$("$WORK/xcheck" -v "$seed" 2>&1 >/dev/null | sed -n 's/.* blocks of \([0-9]*\) bytes.*/\1/p')
+	bsize=${bsize:-512}
+	size=$(od -An -tu4 -j "$bsize" -N 4 "$seed" | tr -d ' ')
+	inodes=$(od -An -tu4 -j $(( bsize + 8 )) -N 4 "$seed" | tr -d ' ')
+	meta=$(( inodes * 64 / bsize + 3 + size / (bsize * 8) + 1 ))
+
+	# Time the seed once per mode
+	IFS=';'
+	for mode in $MODES; do
+		unset IFS
+		read -r status seconds <<< "$(run "$mode" "$seed")"
+		base[$mode]=$seconds
+		IFS=';'
+	done
+	unset IFS
+
+	for iter in $(seq "$ITERS"); do
+		image="$WORK/$name.$iter.img"
+		cp "$seed" "$image"
+		mutate "$image" "$meta" "$inodes" "$bsize"
+
+		keep=0
+		IFS=';'
+		for mode in $MODES; do
+			unset IFS
+			read -r status seconds <<< "$(run "$mode" "$image")"
+
+			# Exit statuses past 1 are timeouts and signals
+			result=""
+			if [ "$status" -eq 124 ]; then
+				result=hang
+			elif [ "$status" -gt 1 ]; then
+				result=crash
+			elif awk -v t="$seconds" -v b="${base[$mode]}" -v f="$SLOW" 'BEGIN { exit !(t > f * b && t > 0.1) }'; then
+				result=slow
+			fi
+
+			if [ -n "$result" ]; then
+				echo "$(basename "$image"),$name,$mode,$result,$seconds,${base[$mode]}"
+				keep=1
+			fi
+			IFS=';'
+		done
+		unset IFS
+
+		if [ "$keep" -eq 1 ]; then
+			flagged=$((flagged + 1))
+		else
+			rm -f "$image"
+		fi
+	done
+done
+
+echo "$flagged images flagged" >&2
+[ "$flagged" -eq 0 ]
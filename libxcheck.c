@@ -0,0 +1,4483 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+#include <pthread.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#include "types_defs.h"
+#include "fs_defs.h"
+#include "xcheck.h"
+
+// Constants
+#define ROOT_INO 1
+
+// Block sizes of the supported layouts. Images are 512 byte blocks unless found otherwise.
+#define MIN_BLOCK_SIZE 512
+#define MAX_BLOCK_SIZE 4096
+
+// Addresses held by an inode, whatever the layout: the direct ones, then the indirect
+// blocks
+#define NADDRS (NDIRECT + 1)
+
+// Bytes at the start of an image which hold the super block and root inode of every layout
+#define PROBE_BYTES (2 * MAX_BLOCK_SIZE + 2 * sizeof(struct dinode))
+
+// Inodes which vote on whether an image has doubly indirect blocks, at most
+#define LAYOUT_VOTES 32
+
+// Declares and defines the kernels of a layout. Each passes the layout's constants to
+// an inlined body, so it is compiled with the layout's own trip counts.
+#define LAYOUT_PROTOTYPES(name) \
+	uint listed##name(struct xcheck*, uint, uint*); \
+	void decode##name(struct xcheck*, uint);
+#define LAYOUT_KERNELS(name, blockSize, ndirect, depth) \
+	uint listed##name(struct xcheck* xc, uint size, uint* addrs){ \
+		return listedFor(xc, size, addrs, blockSize, ndirect, depth); \
+	} \
+	void decode##name(struct xcheck* xc, uint inum){ \
+		decodeFor(xc, inum, blockSize, ndirect, depth); \
+	}
+
+#define T_UNALLOC 0
+#define T_DIR 1
+#define T_FILE 2
+#define T_DEV 3
+
+// Address validation results
+#define ADDR_OK 0
+#define ADDR_BAD_DIRECT 1
+#define ADDR_BAD_INDIRECT 2
+
+// Results of adding a name to a directory's name table, and the directory and block
+// kept when no entry breaks a name rule
+#define NAME_ADDED 0
+#define NAME_REPEATED 1
+#define NAME_BAD 2
+#define NAME_NONE UINT64_MAX
+
+// Number of inodes a sweep worker visits between looking for more work
+#define SWEEP_CHUNK 64
+
+// Geometry of the pread block cache. Lines are aligned and sized for O_DIRECT.
+#define CACHE_LINE_SIZE 4096
+#define CACHE_LINES 1024
+#define BLOCKS_PER_LINE(xc) (CACHE_LINE_SIZE / (xc)->blockSize)
+
+// Maximum number of resident regions a block source hands out
+#define MAX_REGIONS 8
+
+// Access advice given to block sources
+#define ADVISE_WILLNEED 0
+#define ADVISE_SEQUENTIAL 1
+
+// Prefetched blocks closer together than this are fetched as one run
+#define PREFETCH_GAP 8
+
+// Default number of reads the io_uring backend keeps in flight
+#define DEFAULT_QUEUE_DEPTH 32
+
+// Maximum number of stages timed
+#define MAX_STAGES 32
+
+// Default number of findings kept when checking every rule
+#define DEFAULT_MAX_FINDINGS 10000
+
+// Fewest blocks a window of the block maps may cover. Windows are a multiple of 64
+// blocks, so each starts on a whole word of the bitmap.
+#define MIN_WINDOW 512
+
+// Sets of check levels, as bits of XCHECK_LEVEL_* codes
+#define LEVEL_BIT(level) (1 << (level))
+#define QUICK_LEVELS LEVEL_BIT(XCHECK_LEVEL_QUICK)
+#define FULL_LEVELS (LEVEL_BIT(XCHECK_LEVEL_STANDARD) | LEVEL_BIT(XCHECK_LEVEL_DEEP))
+#define DEEP_LEVELS LEVEL_BIT(XCHECK_LEVEL_DEEP)
+
+// Identifies a state file, and the version of its layout
+#define STATE_MAGIC "XCSTATE"
+#define STATE_VERSION 5
+
+// Primes of the xxHash64 digest
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+// Data structure for on-disk block. Block sources which don't keep the
+// image in memory copy the block into buf.
+struct block {
+	char* data;
+	char buf[MAX_BLOCK_SIZE];
+};                 
+
+// A rule checked by xcheck, with the message printed when it is broken
+struct rule {
+	const char* id;
+	const char* message;
+};
+
+// A check, the levels it runs at, and whether it needs the directory tree walked first
+struct check {
+	const char* name;
+	int (*run)(struct xcheck*);
+	int levels;
+	int walk;
+};
+
+// A layout of xv6 images: its block size, and how its inodes address their blocks. An
+// inode holds ndirect direct addresses, then an indirect block, then if depth is 2 a
+// doubly indirect block listing indirect blocks. Each layout has its own kernels,
+// compiled with the layout's constants.
+struct layout {
+	const char* name;
+	uint blockSize;
+	uint ndirect;
+	uint depth;
+	uint (*listed)(struct xcheck*, uint, uint*);  // Data blocks listed by an inode's indirect blocks
+	void (*decode)(struct xcheck*, uint);         // Fills in the row of an inode's addresses
+};
+
+// A block copied into the log, which reads in place of the block it is a copy of
+struct logBlock {
+	uint block;
+	char* data;
+};
+
+// A backend which bread() reads blocks from
+struct blockSource {
+	const char* name;
+	int openFlags;                            // Extra flags to open the image with
+	void (*open)(struct xcheck*);                       // Prepares to read from fd
+	void (*read)(struct xcheck*, uint, struct block*);  // Reads a single block
+	char* (*region)(struct xcheck*, uint, uint);        // Returns a run of blocks which stays resident
+	void (*writable)(struct xcheck*, char*, size_t);    // Lets resident blocks be changed, in memory only
+	void (*advise)(struct xcheck*, uint, uint, int);    // Hints how a run of blocks will be read
+	int windowed;                                       // Prefetch a chunk at a time, not everything up front
+	void (*reload)(struct xcheck*);                     // Drops what it holds of an image changed in place
+	void (*close)(struct xcheck*);                      // Releases the backend's resources
+};
+
+// A line of the pread block cache, holding a run of consecutive blocks
+struct cacheLine {
+	pthread_mutex_t lock;
+	long tag;          // Index of the line in the image, or -1 if empty
+	atomic_int pending;  // Set while an asynchronous read fills the line
+	char* data;
+};
+
+#ifdef HAVE_IO_URING
+// The rings shared with the kernel by the io_uring backend
+struct uring {
+	int fd;
+	pthread_mutex_t lock;    // Guards submission, reaping and inFlight
+	uint inFlight;           // Reads submitted but not yet reaped
+	uint entries;
+	uint* sqHead;
+	uint* sqTail;
+	uint* sqMask;
+	uint* sqArray;
+	struct io_uring_sqe* sqes;
+	uint* cqHead;
+	uint* cqTail;
+	uint* cqMask;
+	struct io_uring_cqe* cqes;
+	void* sqRing;
+	size_t sqRingSize;
+	void* cqRing;
+	size_t cqRingSize;
+	size_t sqesSize;
+};
+#endif
+
+// Results of the inode sweep. Each flag is set when some inode breaks the rule
+// checked by the named test, along with the lowest such inode.
+struct sweepResult {
+	int badInode;      // inodesValidTest
+	int badAddress;    // inodesAddressTest, ADDR_* code of the first bad inode
+	int badDirectory;  // directoryTest
+	int dupDirect;     // directAddressTest, set after the sweep by findDuplicates
+	int dupIndirect;   // indirectAddressTest, set after the sweep by findDuplicates
+	int markedFree;    // inodesInBitmapTest, set after the sweep by compareBitmap
+	int markedUsed;    // bitmapInInodesTest, set after the sweep by compareBitmap
+	uint badInodeInum;
+	uint badAddressInum;
+	uint badDirectoryInum;
+	uint markedFreeBlock;
+	uint markedUsedBlock;
+};
+
+// The inode table decoded once, for every check to share, indexed by inode number. The
+// addresses of each useable inode are a row of addrs, from addrStart[inum] up to
+// addrStart[inum + 1]: the NADDRS addresses the inode holds, then the data blocks its
+// indirect blocks list in file order, then the indirect blocks its doubly indirect block
+// lists. Indirect blocks out of range are never read, and list zeros. Other inodes have
+// empty rows. What indirect blocks list comes out of one budget for the whole image, so
+// a row may list fewer blocks than its inode's size calls for.
+struct inodeIndex {
+	short* type;
+	uint* size;
+	short* nlink;
+	unsigned long* addrStart;
+	uint* listed;           // Data blocks listed by each inode's indirect blocks
+	uint* addrs;
+	uint* used;             // Useable inodes, in order
+	uint nused;
+	int resolve;            // Whether the rows list what the indirect blocks do
+	atomic_uint next;       // Next chunk of inodes to decode
+	uint capacity;          // Inodes the arrays have room for, kept between checks
+	unsigned long addrCapacity; // Addresses addrs has room for
+};
+
+// What the walk of the directory tree found, indexed by inode number. Every
+// directory is scanned once, reachable from the root or not. The walkers update
+// the counts concurrently.
+struct treeWalk {
+	atomic_uint* refs;     // Entries referring to the inode, other than '.' and '..'
+	atomic_uint* parent;   // Lowest reachable directory with an entry for the inode
+	uint* dotdot;          // Inode the directory's '..' entry refers to
+	atomic_uchar* reached; // Set for directories reachable from the root
+	atomic_uint referencedFree; // Lowest unallocated inode some entry refers to, or 0
+	_Atomic uint64_t badName;   // Lowest directory, and block, with a malformed name, or NAME_NONE
+	_Atomic uint64_t dupName;   // Lowest directory, and block, repeating a name, or NAME_NONE
+};
+
+// The names of one directory, in an open addressing table. Each slot holds a whole
+// entry, inode number and name, so a probe compares one 16 byte slot. A slot is full
+// if its stamp is the table's generation, so moving on to the next directory empties
+// the table without clearing it.
+struct nameTable {
+	uchar* slots;
+	uint* stamps;
+	uint cap;               // Slots, a power of two
+	uint count;             // Names in the table
+	uint generation;
+};
+
+// State of one worker of the directory walk. Each worker scans the directories on its
+// own stack, pushing the subdirectories it reaches, and steals from the bottom of
+// another worker's stack when its own is empty.
+struct walker {
+	struct xcheck* xc;
+	pthread_t thread;
+	pthread_mutex_t lock;   // Guards the stack
+	uint* stack;            // Directories waiting to be scanned, in [bottom, top)
+	uint bottom;
+	uint top;
+	uint cap;
+	struct nameTable names; // Names of the directory being scanned
+};
+
+// A block referenced more than once, the inodes holding the first reference and a
+// repeated one, and where in the repeating inode's addresses the repeat is
+struct dupBlock {
+	uint block;
+	uint firstInum;
+	uint repeatInum;
+	uint slot;
+};
+
+// State of one worker of the inode sweep. Each worker owns a range of the
+// inode table, and steals half of another worker's range when it runs dry.
+struct sweeper {
+	struct xcheck* xc;
+	struct sweepResult result;
+	uchar* blockMap;        // Blocks referenced by the inodes this worker visited
+	uchar* dupMap;          // Blocks this worker saw referenced more than once
+	pthread_t thread;
+	pthread_mutex_t lock;   // Guards next and end
+	uint next;              // Next inode to visit
+	uint end;               // End of the range owned by this worker
+};
+
+// Header of a state file. It is followed by the digest of each region, then by the
+// findings kept.
+struct stateHeader {
+	char magic[8];
+	uint version;
+	uint nregions;
+	uint64_t imageBytes;
+	uint blockSize;
+	uint depth;
+	uint size;
+	uint nblocks;
+	uint ninodes;
+	int all;
+	uint64_t maxFindings;
+	int level;
+	int result;            // What xcheckRun returned
+	uint64_t nfindings;
+	uint64_t kept;
+};
+
+// A checker context, holding everything known about the image being checked
+struct xcheck {
+	// First error met, and its description
+	int error;
+	char message[128];
+
+	// How the image is checked
+	int threads;
+	int all;
+	int stats;
+	int level;
+	unsigned long maxFindings;
+
+	// File descriptor of file system, and its size in bytes
+	int fd;
+	size_t size;
+
+	// Layout of the image, and its block size. A layout given in the options is used
+	// as is; otherwise it is found each time the image is read.
+	struct layout* layout;
+	struct layout* givenLayout;
+	uint blockSize;
+
+	// The backend blocks are read from, once it is open
+	struct blockSource* source;
+	int sourceOpen;
+
+	// The beginning address for the file system mapped into the application, and
+	// whether any of its pages were copied to replay the log
+	char* addr;
+	int mapWritten;
+
+	// Memory held by the resident regions of the pread backend
+	char* regions[MAX_REGIONS];
+	int nregions;
+
+	// The pread block cache
+	struct cacheLine* cache;
+	char* cacheData;
+
+	// Number of reads the io_uring backend keeps in flight, and its rings
+	uint queueDepth;
+#ifdef HAVE_IO_URING
+	struct uring ring;
+#endif
+
+	// Super block of the file system
+	struct superblock* superBlock;
+
+	// Points to inodes in the file system
+	struct dinode* inodes;
+
+	// The inodes decoded for the checks
+	struct inodeIndex index;
+
+	// The bitmap for which data blocks have been used. It spans as many blocks
+	// as it takes to hold a bit for every block in the file system.
+	char* bmap;
+
+	// Number of blocks in the bitmap
+	uint bmapBlocks;
+
+	// Number of offset blocks to access the data block region
+	int dataOffset;
+
+	// First blocks of the inode table and the bitmap
+	uint inodeStart;
+	uint bmapStart;
+
+	// The last block of the data region. Older images end it at nblocks, newer ones
+	// at the last block of the file system.
+	uint dataEnd;
+
+	// The log, if the image has one: its header and the committed blocks after it,
+	// which read in place of the blocks they are copies of. The overlay is sorted by
+	// the block replaced.
+	uint logStart;
+	uint logBlocks;
+	char* logHeader;
+	char* logData;
+	uint logCommitted;
+	struct logBlock* overlay;
+	uint noverlay;
+
+	// Bitmap of the blocks referenced by useable inodes in the current window, laid
+	// out like bmap from the window's first block
+	uchar* blockMap;
+
+	// Number of blocks of the file system covered by blockMap
+	uint blockMapLen;
+
+	// Bytes the block maps and block owners are kept within, or 0 for no limit. The
+	// blocks are split into windows of windowBlocks each, swept one at a time, and
+	// the owners of duplicated blocks found ownerBlocks at a time.
+	unsigned long memoryBudget;
+	uint windowBase;
+	uint windowBlocks;
+	uint windows;
+	uint ownerBlocks;
+	uint ownerBase;
+	uint ownerEnd;
+
+	// Bitmap of the blocks referenced more than once across all inodes
+	uchar* dupMap;
+
+	// The first repeated direct and indirect references found, if any
+	struct dupBlock dupDirectBlock;
+	struct dupBlock dupIndirectBlock;
+
+	// Results of the inode sweep, consulted by the tests, and its workers
+	struct sweepResult sweep;
+	struct sweeper* sweepers;
+	int nsweepers;
+
+	// Results of the directory tree walk, consulted by the tests after the sweep's,
+	// its workers, and the number of directories pushed but not yet scanned
+	struct treeWalk walk;
+	struct walker* walkers;
+	int nwalkers;
+	atomic_uint walkPending;
+
+	// Findings collected so far, up to maxFindings of them. nfindings counts every
+	// finding, including those past the cap.
+	struct xcheckFinding* findings;
+	unsigned long nfindings;
+	unsigned long findingsCap;
+	pthread_mutex_t lock;   // Guards the findings and the error
+
+	// Stages timed so far, and the name and starting point of the current one
+	struct xcheckStage stages[MAX_STAGES];
+	int nstages;
+	const char* stageName;
+	struct timespec stageWall;
+	struct rusage stageUsage;
+	unsigned long stageInodes;
+	unsigned long stageBlocks;
+
+	// Counters for the stages, only kept when stats is set
+	atomic_ulong inodesVisited;
+	atomic_ulong blocksRead;
+
+	// Where the digests and verdict are remembered between checks, and whether to
+	// check in full anyway
+	char* statePath;
+	int full;
+
+	// Digest of each region: the super block, each inode table block along with the
+	// blocks its inodes have read, and each bitmap block. The next region to digest,
+	// and how many differ from the state file.
+	uint64_t* digests;
+	uint ndigests;
+	atomic_uint digestNext;
+	uint changedRegions;
+};
+
+// Inode index prototypes
+void decodeInodes(struct xcheck*, int);
+void* decodeWorker(void*);
+uint* inodeAddrs(struct xcheck*, uint, uint*);
+void freeIndex(struct xcheck*);
+
+// Layout prototypes
+struct layout* findLayout(const char*);
+struct layout* layoutFor(uint, uint);
+uint probeBlockSize(struct xcheck*, char*, size_t);
+int plausibleSuperBlock(struct xcheck*, char*, size_t, uint);
+int regionsInOrder(struct superblock*, uint);
+uint voteDepth(struct xcheck*);
+int listsBlocks(struct xcheck*, uint, uint);
+inline uint listedFor(struct xcheck*, uint, uint*, uint, uint, uint);
+inline void decodeFor(struct xcheck*, uint, uint, uint, uint);
+uint listedIndirect(uint, uint);
+void readListed(struct xcheck*, uint, uint*, uint);
+LAYOUT_PROTOTYPES(512)
+LAYOUT_PROTOTYPES(1k)
+LAYOUT_PROTOTYPES(4k)
+LAYOUT_PROTOTYPES(512Double)
+LAYOUT_PROTOTYPES(1kDouble)
+LAYOUT_PROTOTYPES(4kDouble)
+
+// Analysis prototypes
+int runChecks(struct xcheck*);
+void resetChecks(struct xcheck*);
+void sweepInodes(struct xcheck*, int);
+void planWindows(struct xcheck*, int);
+void sweepWindow(struct xcheck*, int);
+void compareBitmap(struct xcheck*);
+void noteMismatch(struct xcheck*, uint, int*, uint*, long);
+void* sweepWorker(void*);
+int sweepTake(struct xcheck*, struct sweeper*, uint*, uint*);
+void sweepInode(struct xcheck*, struct sweeper*, uint);
+void sweepMerge(struct xcheck*, struct sweeper*);
+void findDuplicates(struct xcheck*);
+void prefetchMetadata(struct xcheck*, uint, uint);
+int compareBlocks(const void*, const void*);
+void claimOwners(struct xcheck*, uint*);
+void claimBlock(struct xcheck*, uint*, uint, uint, int, uint);
+int indirectAddressTest(struct xcheck*);
+int directAddressTest(struct xcheck*);
+int directoryTest(struct xcheck*);
+int rootTest(struct xcheck*);
+int validRoot(struct xcheck*);
+int inodesValidTest(struct xcheck*);
+int inodesAddressTest(struct xcheck*);
+int bitmapInInodesTest(struct xcheck*);
+int inodesInBitmapTest(struct xcheck*);
+
+// Quick check prototypes
+int inodeTypesTest(struct xcheck*);
+int rootInodeTest(struct xcheck*);
+int bitmapCountTest(struct xcheck*);
+unsigned long inodeBlocks(struct xcheck*, uint);
+
+// Directory tree prototypes
+void walkTree(struct xcheck*, int);
+void* walkWorker(void*);
+void walkPush(struct xcheck*, struct walker*, uint);
+int walkTake(struct xcheck*, struct walker*, uint*);
+void walkDirectory(struct xcheck*, uint, struct walker*, struct nameTable*);
+uint directoryBlock(struct xcheck*, uint, uint, struct block*);
+void noteName(struct xcheck*, _Atomic uint64_t*, uint, uint, uint);
+int inodesReferencedTest(struct xcheck*);
+int referencesAllocatedTest(struct xcheck*);
+int referenceCountTest(struct xcheck*);
+int directoryOnceTest(struct xcheck*);
+int parentDirectoryTest(struct xcheck*);
+int directoryAccessibleTest(struct xcheck*);
+int entryNamesTest(struct xcheck*);
+int duplicateNamesTest(struct xcheck*);
+
+// Directory name prototypes
+int nameGrow(struct nameTable*);
+void nameReset(struct nameTable*);
+void nameFree(struct nameTable*);
+uint64_t nameHash(const uchar*);
+int nameInsertScalar(struct nameTable*, const struct dirent*);
+#ifdef HAVE_X86_SIMD
+int nameInsertSSE2(struct nameTable*, const struct dirent*);
+#endif
+
+// Finding prototypes
+void setError(struct xcheck*, int, const char*);
+void addFinding(struct xcheck*, uint, uint, uint, uint);
+int compareFindings(const void*, const void*);
+void markAddresses(struct xcheck*, struct sweeper*, uint);
+
+// State prototypes
+void digestRegions(struct xcheck*, int);
+void* digestWorker(void*);
+uint64_t digestRegion(struct xcheck*, uint);
+int digestBlock(struct xcheck*, uint, struct block*, uint64_t*);
+uint64_t digestIndirect(struct xcheck*, uint, int, int, uint64_t);
+int loadState(struct xcheck*);
+void saveState(struct xcheck*, int);
+uint64_t xxh64(const void*, size_t, uint64_t);
+uint64_t xxhRound(uint64_t, uint64_t);
+uint64_t xxhMerge(uint64_t, uint64_t);
+uint64_t xxhRead64(const uchar*);
+uint32_t xxhRead32(const uchar*);
+
+// Stats prototypes
+int runCheck(struct xcheck*, const char*, int (*)(struct xcheck*));
+void statsBegin(struct xcheck*, const char*);
+void statsEnd(struct xcheck*);
+double msSince(struct timespec*);
+double cpuMs(struct rusage*);
+
+// Bitmap prototypes
+void initBitmapKernel();
+long firstAndNot(const uchar*, const uchar*, long, long);
+long firstSet(const uchar*, long, long);
+long countSet(const uchar*, long, long);
+long andNotScalar(const uchar*, const uchar*, long, long);
+#ifdef HAVE_X86_SIMD
+long andNotSSE2(const uchar*, const uchar*, long, long);
+long andNotAVX2(const uchar*, const uchar*, long, long);
+#endif
+
+// Basic utility prototypes
+int dirCheck(uint, uint);
+int validDirect(struct xcheck*, uint);
+int validAddresses(struct xcheck*, uint);
+int rowClipped(struct xcheck*, uint);
+int addressInRange(struct xcheck*, uint);
+uchar* allocBlockMap(struct xcheck*);
+uint blockMapBytes(struct xcheck*);
+uint mapBlocks(struct xcheck*);
+void markBlock(struct xcheck*, struct sweeper*, uint);
+uint directoryEntries(struct xcheck*, uint);
+int blockInUse(struct xcheck*, int);
+int useableType(int);
+int validInode(int);
+int blockBit(struct xcheck*, int);
+long bitmapEnd(struct xcheck*);
+void bread(struct xcheck*, uint, struct block*);
+int init(struct xcheck*, const char*);
+int readImage(struct xcheck*);
+int readRegions(struct xcheck*, struct superblock*);
+int inode2Block(struct xcheck*, int);
+
+// Log prototypes
+int newerLayout(struct superblock*);
+int replayLog(struct xcheck*, struct superblock*);
+void overlayRegion(struct xcheck*, char*, uint, uint);
+char* overlayBlock(struct xcheck*, uint);
+int compareLogBlocks(const void*, const void*);
+
+// Block source prototypes
+struct blockSource* findSource(const char*);
+size_t imageSize(struct xcheck*, struct stat*);
+void mmapOpen(struct xcheck*);
+void mmapRead(struct xcheck*, uint, struct block*);
+char* mmapRegion(struct xcheck*, uint, uint);
+void mmapWritable(struct xcheck*, char*, size_t);
+void mmapAdvise(struct xcheck*, uint, uint, int);
+void mmapReload(struct xcheck*);
+void mmapClose(struct xcheck*);
+void preadOpen(struct xcheck*);
+void preadRead(struct xcheck*, uint, struct block*);
+char* preadRegion(struct xcheck*, uint, uint);
+void preadWritable(struct xcheck*, char*, size_t);
+void preadAdvise(struct xcheck*, uint, uint, int);
+void directAdvise(struct xcheck*, uint, uint, int);
+void preadReload(struct xcheck*);
+void preadClose(struct xcheck*);
+void preadSpan(struct xcheck*, char*, off_t, size_t);
+void preadFill(struct xcheck*, struct cacheLine*, long);
+#ifdef HAVE_IO_URING
+void uringOpen(struct xcheck*);
+void uringRead(struct xcheck*, uint, struct block*);
+void uringAdvise(struct xcheck*, uint, uint, int);
+void uringReload(struct xcheck*);
+void uringClose(struct xcheck*);
+void uringReap(struct xcheck*, int);
+#endif
+
+// Debug prototypes
+void debugDumpDir(struct xcheck*, uint);
+void debugPrintByte(char);
+void debugDumpBlock(struct block, int);
+void int2Binary(int, char[8]);
+void cleanup(struct xcheck*);
+
+// The available block sources. The first is the default.
+struct blockSource SOURCES[] = {
+	{ "mmap", 0, mmapOpen, mmapRead, mmapRegion, mmapWritable, mmapAdvise, 0, mmapReload, mmapClose },
+	{ "pread", 0, preadOpen, preadRead, preadRegion, preadWritable, preadAdvise, 0, preadReload, preadClose },
+#ifdef O_DIRECT
+	{ "direct", O_DIRECT, preadOpen, preadRead, preadRegion, preadWritable, directAdvise, 0, preadReload, preadClose },
+#endif
+#ifdef HAVE_IO_URING
+	{ "uring", 0, uringOpen, uringRead, preadRegion, preadWritable, uringAdvise, 1, uringReload, uringClose },
+#endif
+	{ NULL, 0, NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL }
+};
+
+// The supported layouts. Those with doubly indirect blocks give up the last direct
+// address for it. The first of each block size is the one assumed until an image's
+// inodes vote otherwise.
+struct layout LAYOUTS[] = {
+	{ "512", 512, NDIRECT, 1, listed512, decode512 },
+	{ "1k", 1024, NDIRECT, 1, listed1k, decode1k },
+	{ "4k", 4096, NDIRECT, 1, listed4k, decode4k },
+	{ "512-double", 512, NDIRECT - 1, 2, listed512Double, decode512Double },
+	{ "1k-double", 1024, NDIRECT - 1, 2, listed1kDouble, decode1kDouble },
+	{ "4k-double", 4096, NDIRECT - 1, 2, listed4kDouble, decode4kDouble },
+	{ NULL, 0, 0, 0, NULL, NULL }
+};
+
+// Rules, indexed by the XCHECK_RULE_* codes
+struct rule RULES[] = {
+	{ "inode-type", "bad inode" },
+	{ "direct-address", "bad direct address in inode." },
+	{ "indirect-address", "bad indirect address in inode." },
+	{ "root", "root directory does not exit." },
+	{ "directory-format", "directory not properly formatted." },
+	{ "marked-free", "address used by inode marked free in bitmap." },
+	{ "marked-used", "bitmap marks block in use but it is not in use." },
+	{ "direct-duplicate", "direct address used more than once." },
+	{ "indirect-duplicate", "indirect address used more than once." },
+	{ "unreferenced", "inode marked use but not found in a directory." },
+	{ "referenced-free", "inode referred to in directory but marked free." },
+	{ "reference-count", "bad reference count for file." },
+	{ "directory-once", "directory appears more than once in file system." },
+	{ "parent-mismatch", "parent directory mismatch." },
+	{ "inaccessible", "inaccessible directory exists." },
+	{ "bitmap-count", "bitmap marks a different number of blocks in use than inodes refer to." },
+	{ "entry-name", "directory entry name not properly formatted." },
+	{ "duplicate-name", "name appears more than once in directory." }
+};
+
+// The checks, in the order they run
+struct check CHECKS[] = {
+	{ "inodeTypesTest", inodeTypesTest, QUICK_LEVELS, 0 },
+	{ "rootInodeTest", rootInodeTest, QUICK_LEVELS, 0 },
+	{ "bitmapCountTest", bitmapCountTest, QUICK_LEVELS, 0 },
+	{ "inodesValidTest", inodesValidTest, FULL_LEVELS, 0 },
+	{ "inodesAddressTest", inodesAddressTest, FULL_LEVELS, 0 },
+	{ "rootTest", rootTest, FULL_LEVELS, 0 },
+	{ "directoryTest", directoryTest, FULL_LEVELS, 0 },
+	{ "inodesInBitmapTest", inodesInBitmapTest, FULL_LEVELS, 0 },
+	{ "bitmapInInodesTest", bitmapInInodesTest, FULL_LEVELS, 0 },
+	{ "directAddressTest", directAddressTest, FULL_LEVELS, 0 },
+	{ "indirectAddressTest", indirectAddressTest, FULL_LEVELS, 0 },
+	{ "inodesReferencedTest", inodesReferencedTest, DEEP_LEVELS, 1 },
+	{ "referencesAllocatedTest", referencesAllocatedTest, DEEP_LEVELS, 1 },
+	{ "referenceCountTest", referenceCountTest, DEEP_LEVELS, 1 },
+	{ "directoryOnceTest", directoryOnceTest, DEEP_LEVELS, 1 },
+	{ "parentDirectoryTest", parentDirectoryTest, DEEP_LEVELS, 1 },
+	{ "directoryAccessibleTest", directoryAccessibleTest, DEEP_LEVELS, 1 },
+	{ "entryNamesTest", entryNamesTest, DEEP_LEVELS, 1 },
+	{ "duplicateNamesTest", duplicateNamesTest, DEEP_LEVELS, 1 },
+	{ NULL, NULL, 0, 0 }
+};
+
+// Finds the first byte in a range where the first bitmap has a bit the second lacks.
+// Chosen at runtime from the instruction sets the CPU supports.
+long (*AND_NOT_KERNEL)(const uchar*, const uchar*, long, long);
+
+// Adds a directory entry's name to a name table, returning one of the NAME_* codes.
+// Chosen at runtime alongside AND_NOT_KERNEL.
+int (*NAME_KERNEL)(struct nameTable*, const struct dirent*);
+pthread_once_t KERNEL_ONCE = PTHREAD_ONCE_INIT;
+
+// What a block past the end of the image reads as
+const char ZERO_BLOCK[MAX_BLOCK_SIZE];
+
+// ***
+// *
+// *   Library functions
+// *
+// ***
+
+// Creates a checker context, or returns NULL if the options name no known source,
+// layout or level, or memory runs out
+struct xcheck* xcheckNew(const struct xcheckOptions* options){
+	struct blockSource* source = &SOURCES[0];
+	if(options->source != NULL)
+		source = findSource(options->source);
+	if(source == NULL)
+		return NULL;
+
+	struct layout* layout = NULL;
+	if(options->layout != NULL && (layout = findLayout(options->layout)) == NULL)
+		return NULL;
+
+	if(options->level < 0 || options->level > XCHECK_LEVEL_DEEP)
+		return NULL;
+
+	struct xcheck* xc = calloc(1, sizeof(struct xcheck));
+	if(xc == NULL)
+		return NULL;
+
+	xc->source = source;
+	xc->givenLayout = layout;
+	xc->fd = -1;
+	xc->threads = options->threads > 0 ? options->threads : 1;
+	xc->queueDepth = options->queueDepth > 0 ? options->queueDepth : DEFAULT_QUEUE_DEPTH;
+	xc->all = options->all;
+	xc->maxFindings = options->maxFindings > 0 ? options->maxFindings : DEFAULT_MAX_FINDINGS;
+	xc->stats = options->stats;
+	xc->memoryBudget = options->memoryBudget;
+	xc->level = options->level != 0 ? options->level : XCHECK_LEVEL_DEEP;
+	xc->full = options->full;
+	pthread_mutex_init(&xc->lock, NULL);
+
+	if(options->state != NULL){
+		xc->statePath = strdup(options->state);
+		if(xc->statePath == NULL){
+			free(xc);
+			return NULL;
+		}
+	}
+
+	pthread_once(&KERNEL_ONCE, initBitmapKernel);
+	return xc;
+}
+
+// Opens an image for checking, returning XCHECK_OK or an error
+int xcheckOpen(struct xcheck* xc, const char* image){
+	statsBegin(xc, "init");
+	if(init(xc, image) == XCHECK_OK)
+		readImage(xc);
+	statsEnd(xc);
+
+	return xc->error;
+}
+
+// Reads the open image again after it has changed in place, so it can be checked
+// anew. The file, the mapping or block cache, and the inode index's memory are kept
+// unless the image has changed size. Returns XCHECK_OK or an error.
+int xcheckRefresh(struct xcheck* xc){
+	if(!xc->sourceOpen)
+		return xc->error != XCHECK_OK ? xc->error : XCHECK_EOPEN;
+
+	resetChecks(xc);
+	xc->error = XCHECK_OK;
+	xc->message[0] = '\0';
+
+	statsBegin(xc, "init");
+	struct stat finfo;
+	size_t size = 0;
+	if(fstat(xc->fd, &finfo) < 0)
+		setError(xc, XCHECK_EOPEN, "could not load image statistics");
+	else
+		size = imageSize(xc, &finfo);
+
+	// A mapping or cache sized for the old image is no use for the new one
+	if(xc->error == XCHECK_OK && size != xc->size){
+		xc->source->close(xc);
+		xc->sourceOpen = 0;
+		xc->size = size;
+		if(xc->size < 2 * MIN_BLOCK_SIZE)
+			setError(xc, XCHECK_EFORMAT, "image too small");
+		else
+			xc->source->open(xc);
+		if(xc->error == XCHECK_OK)
+			xc->sourceOpen = 1;
+	} else if(xc->error == XCHECK_OK){
+		xc->source->reload(xc);
+		if(xc->error != XCHECK_OK)
+			xc->sourceOpen = 0;
+	}
+
+	if(xc->error == XCHECK_OK)
+		readImage(xc);
+	statsEnd(xc);
+
+	return xc->error;
+}
+
+// Checks the open image, passing what it finds to sink in the order the rules are
+// checked. Unless every rule is checked, the check stops at the first broken.
+int xcheckRun(struct xcheck* xc, xcheckSink sink, void* arg){
+	if(xc->superBlock == NULL)
+		return xc->error != XCHECK_OK ? xc->error : XCHECK_EOPEN;
+
+	// Reuse the last verdict if nothing it was based on has changed
+	int result = -1;
+	if(xc->statePath != NULL){
+		statsBegin(xc, "digestRegions");
+		digestRegions(xc, xc->threads);
+		statsEnd(xc);
+
+		if(xc->error != XCHECK_OK)
+			return xc->error;
+
+		result = loadState(xc);
+	}
+
+	if(result < 0)
+		result = runChecks(xc);
+	if(result < 0)
+		return result;
+
+	unsigned long kept = xc->nfindings < xc->findingsCap ? xc->nfindings : xc->findingsCap;
+	unsigned long j;
+	for(j = 0; j < kept; j++){
+		sink(arg, &xc->findings[j]);
+	}
+
+	return result;
+}
+
+// Checks every rule against the open image, or up to the first broken, and sorts the
+// findings. Remembers the verdict if there is a state file.
+int runChecks(struct xcheck* xc){
+	// Decode the inode table for the checks to share. Quick checks read nothing but
+	// the inode table and bitmap, so leave the indirect blocks unread.
+	xc->index.resolve = xc->level != XCHECK_LEVEL_QUICK;
+	decodeInodes(xc, xc->threads);
+	if(xc->error != XCHECK_OK)
+		return xc->error;
+
+	// Apply every per-inode rule in a single pass over the inode index
+	if(xc->level != XCHECK_LEVEL_QUICK)
+		sweepInodes(xc, xc->threads);
+
+	// Run the tests of the level
+	int walked = 0;
+	int i;
+	for(i = 0; CHECKS[i].name != NULL && xc->error == XCHECK_OK; i++){
+		if(!(CHECKS[i].levels & LEVEL_BIT(xc->level)))
+			continue;
+
+		// The rest of the tests need the directory tree walked
+		if(CHECKS[i].walk && !walked){
+			statsBegin(xc, "walkTree");
+			walkTree(xc, xc->threads);
+			statsEnd(xc);
+			walked = 1;
+
+			if(xc->error != XCHECK_OK)
+				break;
+		}
+
+		if(!runCheck(xc, CHECKS[i].name, CHECKS[i].run) && !xc->all)
+			break;
+	}
+
+	if(xc->error != XCHECK_OK)
+		return xc->error;
+
+	// The workers record findings in whatever order they finish
+	unsigned long kept = xc->nfindings < xc->findingsCap ? xc->nfindings : xc->findingsCap;
+	if(kept > 0)
+		qsort(xc->findings, kept, sizeof(struct xcheckFinding), compareFindings);
+
+	int result = xc->nfindings > 0 ? XCHECK_FOUND : XCHECK_OK;
+	if(xc->statePath != NULL)
+		saveState(xc, result);
+
+	return xc->error != XCHECK_OK ? xc->error : result;
+}
+
+// Frees what the last check found and built, leaving the image open and the inode
+// index's memory for the next check to reuse
+void resetChecks(struct xcheck* xc){
+	free(xc->blockMap);
+	free(xc->dupMap);
+	free(xc->walk.refs);
+	free(xc->walk.parent);
+	free(xc->walk.dotdot);
+	free(xc->walk.reached);
+	free(xc->findings);
+	free(xc->digests);
+	xc->blockMap = NULL;
+	xc->dupMap = NULL;
+	xc->findings = NULL;
+	xc->digests = NULL;
+	memset(&xc->walk, 0, sizeof(xc->walk));
+	memset(&xc->sweep, 0, sizeof(xc->sweep));
+	memset(&xc->dupDirectBlock, 0, sizeof(xc->dupDirectBlock));
+	memset(&xc->dupIndirectBlock, 0, sizeof(xc->dupIndirectBlock));
+
+	xc->blockMapLen = 0;
+	xc->windowBase = 0;
+	xc->windowBlocks = 0;
+	xc->windows = 0;
+	xc->ownerBlocks = 0;
+	xc->ownerBase = 0;
+	xc->ownerEnd = 0;
+	xc->nfindings = 0;
+	xc->findingsCap = 0;
+	xc->nstages = 0;
+	xc->ndigests = 0;
+	xc->changedRegions = 0;
+	atomic_store(&xc->digestNext, 0);
+	atomic_store(&xc->walkPending, 0);
+	atomic_store(&xc->inodesVisited, 0);
+	atomic_store(&xc->blocksRead, 0);
+}
+
+// Closes the image and frees the context
+void xcheckFree(struct xcheck* xc){
+	cleanup(xc);
+	pthread_mutex_destroy(&xc->lock);
+	free(xc);
+}
+
+// Returns the number of findings, including those past the cap
+unsigned long xcheckFindings(struct xcheck* xc){
+	return xc->nfindings;
+}
+
+// Returns a description of the last error
+const char* xcheckError(struct xcheck* xc){
+	return xc->message;
+}
+
+// Returns the name of the block source in use
+const char* xcheckSource(struct xcheck* xc){
+	return xc->source->name;
+}
+
+// Points stages at the stages timed so far, returning how many there are
+int xcheckStages(struct xcheck* xc, const struct xcheckStage** stages){
+	*stages = xc->stages;
+	return xc->nstages;
+}
+
+// Fills in the geometry of the open image
+void xcheckGeometry(struct xcheck* xc, struct xcheckGeometry* geometry){
+	memset(geometry, 0, sizeof(*geometry));
+	if(xc->superBlock == NULL)
+		return;
+
+	geometry->layout = xc->layout->name;
+	geometry->blockSize = xc->blockSize;
+	geometry->size = xc->superBlock->size;
+	geometry->nblocks = xc->superBlock->nblocks;
+	geometry->ninodes = xc->superBlock->ninodes;
+	geometry->bitmapBlocks = xc->bmapBlocks;
+	geometry->dataOffset = xc->dataOffset;
+	geometry->inodeStart = xc->inodeStart;
+	geometry->logBlocks = xc->logBlocks;
+	geometry->logReplayed = xc->noverlay;
+	geometry->mapBytes = blockMapBytes(xc);
+	geometry->windows = xc->windows;
+	geometry->windowBlocks = xc->windowBlocks;
+	geometry->imageBytes = xc->size;
+}
+
+// Returns the number of regions digested, and sets changed to how many differ from the
+// state file. Every region has changed when there was no usable state.
+unsigned int xcheckRegions(struct xcheck* xc, unsigned int* changed){
+	*changed = xc->changedRegions;
+	return xc->ndigests;
+}
+
+// Returns 1 if there is a block source with the given name, 0 otherwise
+int xcheckHasSource(const char* name){
+	return findSource(name) != NULL;
+}
+
+// Returns 1 if there is a layout with the given name, 0 otherwise
+int xcheckHasLayout(const char* name){
+	return findLayout(name) != NULL;
+}
+
+// Returns a short identifier for a rule
+const char* xcheckRuleId(unsigned int rule){
+	return rule < XCHECK_RULES ? RULES[rule].id : "unknown";
+}
+
+// Returns the message printed when a rule is broken
+const char* xcheckRuleMessage(unsigned int rule){
+	return rule < XCHECK_RULES ? RULES[rule].message : "unknown rule broken.";
+}
+
+// Records the first error met. Later ones are ignored.
+void setError(struct xcheck* xc, int code, const char* message){
+	pthread_mutex_lock(&xc->lock);
+	if(xc->error == XCHECK_OK){
+		xc->error = code;
+		snprintf(xc->message, sizeof(xc->message), "%s", message);
+	}
+	pthread_mutex_unlock(&xc->lock);
+}
+
+// ***
+// *
+// *   Inode index functions
+// *
+// ***
+
+// Decodes the inode table into the inode index. The types, sizes and link counts are
+// copied, and the rows laid out, in one pass. The rows are then filled a chunk of
+// inodes at a time by the given number of threads, reading each indirect block once
+// through the kernel of the image's layout.
+void decodeInodes(struct xcheck* xc, int threads){
+	struct inodeIndex* index = &xc->index;
+	uint ninodes = xc->superBlock->ninodes;
+
+	// Start fetching the indirect blocks, and the directory blocks the sweep reads
+	// next, in disk order. Windowed sources fetch each chunk's blocks as the decode
+	// reaches it instead.
+	if(index->resolve && !xc->source->windowed){
+		statsBegin(xc, "prefetchMetadata");
+		prefetchMetadata(xc, 0, ninodes);
+		statsEnd(xc);
+	}
+
+	statsBegin(xc, "decodeInodes");
+
+	// There is always room for one inode, so an empty table still allocates. A
+	// context checking its image again keeps the arrays if they are large enough.
+	index->nused = 0;
+	atomic_store(&index->next, 0);
+	if(index->capacity < ninodes + 1){
+		freeIndex(xc);
+		index->type = malloc(((size_t)ninodes + 1) * sizeof(short));
+		index->size = malloc(((size_t)ninodes + 1) * sizeof(uint));
+		index->nlink = malloc(((size_t)ninodes + 1) * sizeof(short));
+		index->addrStart = malloc(((size_t)ninodes + 1) * sizeof(unsigned long));
+		index->listed = malloc(((size_t)ninodes + 1) * sizeof(uint));
+		index->used = malloc(((size_t)ninodes + 1) * sizeof(uint));
+		if(index->type == NULL || index->size == NULL || index->nlink == NULL ||
+		   index->addrStart == NULL || index->listed == NULL || index->used == NULL){
+			setError(xc, XCHECK_ENOMEM, "could not allocate inode index");
+			return;
+		}
+		index->capacity = ninodes + 1;
+	}
+
+	// Lay out the rows. An indirect block out of range fails the address test, and
+	// is never read. A consistent image lists each data block once at most, so the
+	// blocks listed by every inode's indirect blocks, and the indirect blocks listing
+	// them, fit in the data region. Rows stop listing once they don't, and those cut
+	// short fail the address test, so the index is bounded by the inode table and the
+	// data region together whatever sizes the inodes claim.
+	uint nindirect = xc->blockSize / sizeof(uint);
+	unsigned long budget = xc->dataEnd >= (uint)xc->dataOffset ? xc->dataEnd - xc->dataOffset + 1 : 0;
+	unsigned long at = 0;
+	uint i;
+	for(i = 0; i < ninodes; i++){
+		struct dinode* inode = &xc->inodes[i];
+		index->type[i] = inode->type;
+		index->size[i] = inode->size;
+		index->nlink[i] = inode->nlink;
+		index->addrStart[i] = at;
+		index->listed[i] = 0;
+		if(!useableType(inode->type))
+			continue;
+
+		index->used[index->nused++] = i;
+		at += NADDRS;
+		if(index->resolve){
+			uint listed = xc->layout->listed(xc, inode->size, inode->addrs);
+			unsigned long cost = listed + listedIndirect(listed, nindirect);
+			if(cost > budget){
+				if(budget <= nindirect)
+					listed = budget;
+				else
+					listed = nindirect + (budget - nindirect - 1) * nindirect / (nindirect + 1);
+				cost = listed + listedIndirect(listed, nindirect);
+			}
+			budget -= cost;
+
+			index->listed[i] = listed;
+			at += cost;
+		}
+	}
+	index->addrStart[ninodes] = at;
+
+	if(index->addrCapacity < at + 1){
+		free(index->addrs);
+		index->addrs = malloc((at + 1) * sizeof(uint));
+		if(index->addrs == NULL){
+			index->addrCapacity = 0;
+			setError(xc, XCHECK_ENOMEM, "could not allocate inode index");
+			return;
+		}
+		index->addrCapacity = at + 1;
+	}
+
+	// There is no use for more workers than chunks of inodes
+	if((uint)threads > ninodes / SWEEP_CHUNK + 1)
+		threads = ninodes / SWEEP_CHUNK + 1;
+
+	// A single worker runs on the main thread. The chunks of a worker which can't be
+	// started are taken by the others.
+	pthread_t* workers = calloc(threads, sizeof(pthread_t));
+	int started = 0;
+	if(threads > 1 && workers != NULL){
+		for(started = 0; started < threads; started++){
+			if(pthread_create(&workers[started], NULL, decodeWorker, xc) != 0)
+				break;
+		}
+	}
+
+	if(started == 0)
+		decodeWorker(xc);
+
+	int j;
+	for(j = 0; j < started; j++){
+		pthread_join(workers[j], NULL);
+	}
+	free(workers);
+
+	statsEnd(xc);
+}
+
+// Decodes chunks of inodes until there are none left to take
+void* decodeWorker(void* arg){
+	struct xcheck* xc = arg;
+	uint ninodes = xc->superBlock->ninodes;
+	uint chunks = (ninodes + SWEEP_CHUNK - 1) / SWEEP_CHUNK;
+
+	uint chunk;
+	while((chunk = atomic_fetch_add(&xc->index.next, 1)) < chunks){
+		uint start = chunk * SWEEP_CHUNK;
+		uint end = ninodes - start > SWEEP_CHUNK ? start + SWEEP_CHUNK : ninodes;
+
+		// Have the chunk's blocks in flight while the first inodes are decoded
+		if(xc->index.resolve && xc->source->windowed)
+			prefetchMetadata(xc, start, end);
+
+		uint i;
+		for(i = start; i < end; i++){
+			xc->layout->decode(xc, i);
+		}
+
+		if(xc->stats)
+			atomic_fetch_add_explicit(&xc->inodesVisited, end - start, memory_order_relaxed);
+	}
+
+	return NULL;
+}
+
+// Returns the row of an inode's addresses, and sets length to how many it holds. The
+// first NADDRS are the inode's own, then the addresses its indirect blocks list.
+uint* inodeAddrs(struct xcheck* xc, uint inum, uint* length){
+	unsigned long start = xc->index.addrStart[inum];
+	*length = xc->index.addrStart[inum + 1] - start;
+
+	return &xc->index.addrs[start];
+}
+
+// Frees the arrays of the inode index
+void freeIndex(struct xcheck* xc){
+	struct inodeIndex* index = &xc->index;
+	free(index->type);
+	free(index->size);
+	free(index->nlink);
+	free(index->addrStart);
+	free(index->listed);
+	free(index->used);
+	free(index->addrs);
+	index->type = NULL;
+	index->size = NULL;
+	index->nlink = NULL;
+	index->addrStart = NULL;
+	index->listed = NULL;
+	index->used = NULL;
+	index->addrs = NULL;
+	index->capacity = 0;
+	index->addrCapacity = 0;
+}
+
+// ***
+// *
+// *   Layout functions
+// *
+// ***
+
+// Returns the layout with the given name, or NULL if there is none
+struct layout* findLayout(const char* name){
+	int i;
+	for(i = 0; LAYOUTS[i].name != NULL; i++){
+		if(strcmp(LAYOUTS[i].name, name) == 0)
+			return &LAYOUTS[i];
+	}
+
+	return NULL;
+}
+
+// Returns the layout with the given block size and depth of indirection, or NULL if
+// there is none
+struct layout* layoutFor(uint blockSize, uint depth){
+	int i;
+	for(i = 0; LAYOUTS[i].name != NULL; i++){
+		if(LAYOUTS[i].blockSize == blockSize && LAYOUTS[i].depth == depth)
+			return &LAYOUTS[i];
+	}
+
+	return NULL;
+}
+
+// Returns the block size of an image, given the first bytes of it at head: the smallest
+// at which the super block and root inode look like an xv6 file system's. Images which
+// look like none are taken to have 512 byte blocks, and checked as such.
+uint probeBlockSize(struct xcheck* xc, char* head, size_t headBytes){
+	int i;
+	for(i = 0; LAYOUTS[i].name != NULL; i++){
+		if(LAYOUTS[i].depth == 1 && plausibleSuperBlock(xc, head, headBytes, LAYOUTS[i].blockSize))
+			return LAYOUTS[i].blockSize;
+	}
+
+	return MIN_BLOCK_SIZE;
+}
+
+// Returns 1 if an image would be a plausible xv6 file system with the given block
+// size: the super block describes data blocks within an image no larger than this
+// one, and the root inode is a directory. The root inode of the newer layout lies
+// past the log, so the regions its super block describes must be in order instead.
+int plausibleSuperBlock(struct xcheck* xc, char* head, size_t headBytes, uint blockSize){
+	// The root inode follows inode 0 at the start of the inode table
+	if(2 * (size_t)blockSize + 2 * sizeof(struct dinode) > headBytes)
+		return 0;
+
+	struct superblock* superBlock = (struct superblock*)&head[blockSize];
+	if(superBlock->size == 0 || superBlock->ninodes == 0 || superBlock->nblocks == 0 ||
+	   superBlock->nblocks >= superBlock->size || (size_t)superBlock->size * blockSize > xc->size)
+		return 0;
+
+	if(newerLayout(superBlock))
+		return regionsInOrder(superBlock, blockSize);
+
+	struct dinode* root = (struct dinode*)&head[2 * blockSize + sizeof(struct dinode)];
+	return root->type == T_DIR;
+}
+
+// Returns 1 if the regions a newer super block describes lie in order within the file
+// system, given its block size: the log from block 2 on, then an inode table with room
+// for every inode, then a bitmap with a bit for every block
+int regionsInOrder(struct superblock* superBlock, uint blockSize){
+	if(superBlock->size == 0)
+		return 0;
+
+	unsigned long inodeBlocks = superBlock->ninodes / (blockSize / sizeof(struct dinode)) + 1;
+	unsigned long bmapBlocks = (superBlock->size - 1) / (blockSize * 8) + 1;
+	return (superBlock->nlog == 0 || superBlock->logstart >= 2) &&
+		(unsigned long)superBlock->logstart + superBlock->nlog <= superBlock->inodestart &&
+		superBlock->inodestart + inodeBlocks <= superBlock->bmapstart &&
+		superBlock->bmapstart + bmapBlocks <= superBlock->size;
+}
+
+// Returns the depth of indirection of an image, once its block size is known. Files
+// too big for the direct blocks, but small enough for a single indirect block, vote:
+// where the last slot is a doubly indirect block, theirs is empty and the one before
+// it, their indirect block, lists just the blocks their size calls for. Files too big
+// for a single indirect block vote for doubly indirect blocks only if their last slot
+// reads as one, listing just the indirect blocks their size calls for. The first
+// LAYOUT_VOTES votes decide, and at most as many blocks are read for them. Files of
+// exactly NDIRECT blocks fill the direct slots either way, so their last block is read:
+// with doubly indirect blocks it is an indirect block listing a single address. That
+// is weaker evidence, as a data block may read the same, so these files only break
+// the tie when no other file voted. A tie keeps single indirect blocks.
+uint voteDepth(struct xcheck* xc){
+	uint nindirect = xc->blockSize / sizeof(uint);
+	uint single = 0, doubly = 0;
+	uint filledSingle = 0, filledDoubly = 0, reads = 0;
+
+	uint i;
+	for(i = 0; i < xc->superBlock->ninodes && single + doubly < LAYOUT_VOTES; i++){
+		struct dinode* inode = &xc->inodes[i];
+		if(!useableType(inode->type))
+			continue;
+
+		unsigned long blocks = ((unsigned long)inode->size + xc->blockSize - 1) / xc->blockSize;
+		if(blocks < NDIRECT)
+			continue;
+
+		if(blocks == NDIRECT){
+			if(filledSingle + filledDoubly >= LAYOUT_VOTES)
+				continue;
+			if(inode->addrs[NDIRECT - 1] == 0 || !addressInRange(xc, inode->addrs[NDIRECT - 1]))
+				continue;
+
+			if(listsBlocks(xc, inode->addrs[NDIRECT - 1], 1))
+				filledDoubly++;
+			else
+				filledSingle++;
+		} else if(blocks <= NDIRECT - 1 + nindirect && inode->addrs[NDIRECT] != 0){
+			single++;
+		} else{
+			// Each read is bounded, however many files claim to be this big
+			if(reads >= LAYOUT_VOTES)
+				continue;
+			reads++;
+
+			// Past the direct blocks, the file is in its indirect block if that holds
+			// it, or else in the indirect blocks its doubly indirect block lists
+			uint listed = blocks - (NDIRECT - 1) < nindirect + nindirect * nindirect ?
+				blocks - (NDIRECT - 1) : nindirect + nindirect * nindirect;
+			if(listed <= nindirect){
+				if(inode->addrs[NDIRECT] == 0 && listsBlocks(xc, inode->addrs[NDIRECT - 1], listed))
+					doubly++;
+			} else if(listsBlocks(xc, inode->addrs[NDIRECT], listedIndirect(listed, nindirect))){
+				doubly++;
+			}
+		}
+	}
+
+	if(single + doubly == 0){
+		single = filledSingle;
+		doubly = filledDoubly;
+	}
+
+	return doubly > single ? 2 : 1;
+}
+
+// Returns 1 if the block at address is in range and reads as a block of addresses
+// listing count blocks in range, and nothing after them
+int listsBlocks(struct xcheck* xc, uint address, uint count){
+	if(address == 0 || !addressInRange(xc, address))
+		return 0;
+
+	struct block b;
+	bread(xc, address, &b);
+
+	uint* listed = (uint*)b.data;
+	uint i;
+	for(i = 0; i < xc->blockSize / sizeof(uint); i++){
+		if(i < count ? listed[i] == 0 || !addressInRange(xc, listed[i]) : listed[i] != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+// Returns the number of data blocks an inode's indirect blocks list in its row: as
+// many as its size needs past the direct blocks, up to what the layout addresses.
+// Indirect blocks out of range aren't read, so the row lists nothing unless the
+// indirect or doubly indirect block is in range, and nothing past what the indirect
+// block holds unless the doubly indirect one is. No file holds more blocks than the
+// image has. The layout is passed as constants by its kernel.
+__attribute__((always_inline))
+inline uint listedFor(struct xcheck* xc, uint size, uint* addrs, uint blockSize, uint ndirect, uint depth){
+	uint nindirect = blockSize / sizeof(uint);
+	if(size <= ndirect * blockSize)
+		return 0;
+
+	// The size past the direct blocks, rounded up to whole blocks
+	uint listed = (size - ndirect * blockSize + blockSize - 1) / blockSize;
+	int single = addrs[ndirect] != 0 && addressInRange(xc, addrs[ndirect]);
+	if(depth == 1 || listed <= nindirect || addrs[ndirect + 1] == 0 || !addressInRange(xc, addrs[ndirect + 1])){
+		if(!single)
+			return 0;
+
+		return listed < nindirect ? listed : nindirect;
+	}
+
+	if(listed > nindirect + nindirect * nindirect)
+		listed = nindirect + nindirect * nindirect;
+	if(listed - nindirect > xc->superBlock->nblocks)
+		listed = nindirect + xc->superBlock->nblocks;
+
+	return listed;
+}
+
+// Fills in the row of an inode's addresses: the inode's own, then what its indirect
+// blocks list, reading each once. The layout is passed as constants by its kernel.
+__attribute__((always_inline))
+inline void decodeFor(struct xcheck* xc, uint inum, uint blockSize, uint ndirect, uint depth){
+	uint nindirect = blockSize / sizeof(uint);
+	uint length;
+	uint* row = inodeAddrs(xc, inum, &length);
+	if(length == 0)
+		return;
+
+	memcpy(row, xc->inodes[inum].addrs, NADDRS * sizeof(uint));
+	if(length == NADDRS)
+		return;
+
+	uint listed = xc->index.listed[inum];
+	readListed(xc, row[ndirect], &row[NADDRS], listed < nindirect ? listed : nindirect);
+	if(depth == 1 || listed <= nindirect)
+		return;
+
+	// The doubly indirect block lists indirect blocks, each listing the next run of data blocks
+	uint count = listedIndirect(listed, nindirect);
+	uint* indirect = &row[NADDRS + listed];
+	readListed(xc, row[ndirect + 1], indirect, count);
+
+	uint i;
+	for(i = 0; i < count; i++){
+		uint first = nindirect + i * nindirect;
+		readListed(xc, indirect[i], &row[NADDRS + first], listed - first < nindirect ? listed - first : nindirect);
+	}
+}
+
+// Returns the number of indirect blocks a doubly indirect block lists for a file with
+// the given number of listed data blocks
+uint listedIndirect(uint listed, uint nindirect){
+	if(listed <= nindirect)
+		return 0;
+
+	return (listed - nindirect + nindirect - 1) / nindirect;
+}
+
+// Copies the first count addresses an indirect block lists into addrs. An indirect
+// block out of range isn't read, and lists zeros.
+void readListed(struct xcheck* xc, uint address, uint* addrs, uint count){
+	if(address == 0 || !addressInRange(xc, address)){
+		memset(addrs, 0, count * sizeof(uint));
+		return;
+	}
+
+	struct block b;
+	bread(xc, address, &b);
+	memcpy(addrs, b.data, count * sizeof(uint));
+}
+
+// The kernels of each layout
+LAYOUT_KERNELS(512, 512, NDIRECT, 1)
+LAYOUT_KERNELS(1k, 1024, NDIRECT, 1)
+LAYOUT_KERNELS(4k, 4096, NDIRECT, 1)
+LAYOUT_KERNELS(512Double, 512, NDIRECT - 1, 2)
+LAYOUT_KERNELS(1kDouble, 1024, NDIRECT - 1, 2)
+LAYOUT_KERNELS(4kDouble, 4096, NDIRECT - 1, 2)
+
+// ***
+// *
+// *   Analysis functions
+// *
+// ***
+
+// Visits every inode and the addresses it was decoded with, applying all of the
+// per-inode rules in that visit. The inode table is split between the given number
+// of threads. The tests below report the merged results in their original order.
+// Under a memory budget the blocks are split into windows, and the inode table is
+// swept once per window.
+void sweepInodes(struct xcheck* xc, int threads){
+	uint ninodes = xc->superBlock->ninodes;
+
+	// There is no use for more workers than chunks of inodes
+	if((uint)threads > ninodes / SWEEP_CHUNK + 1)
+		threads = ninodes / SWEEP_CHUNK + 1;
+
+	planWindows(xc, threads);
+	if(xc->error != XCHECK_OK)
+		return;
+
+	uint i;
+	for(i = 0; i < xc->windows && xc->error == XCHECK_OK; i++){
+		// Only one window's maps are held at a time
+		free(xc->blockMap);
+		free(xc->dupMap);
+		xc->blockMap = NULL;
+		xc->dupMap = NULL;
+
+		xc->windowBase = i * xc->windowBlocks;
+		sweepWindow(xc, threads);
+
+		// Stopping at the first rule broken, there is no need to sweep the later
+		// windows once a rule checked before the duplicate rules is broken
+		if(!xc->all && (xc->sweep.badInode || xc->sweep.badAddress != ADDR_OK || xc->sweep.badDirectory || xc->sweep.markedFree))
+			break;
+	}
+}
+
+// Sizes the windows of blocks to fit the memory budget. While sweeping, each worker
+// holds a block map and a duplicate map of the window. Once they are merged, the
+// owners of duplicated blocks take what is left, at four bytes a block. Without a
+// budget there is one window of every block.
+void planWindows(struct xcheck* xc, int threads){
+	uint blocks = mapBlocks(xc);
+	xc->windowBlocks = blocks;
+	xc->windows = 1;
+	xc->ownerBlocks = blocks;
+	if(xc->memoryBudget == 0)
+		return;
+
+	// Split the budget so the owners get at least what the merged maps don't
+	unsigned long windowBlocks = xc->memoryBudget / (2 * threads + 2) * 8 / 64 * 64;
+	if(windowBlocks < MIN_WINDOW){
+		setError(xc, XCHECK_ENOMEM, "memory budget too small for the block maps");
+		return;
+	}
+
+	if(windowBlocks < blocks){
+		xc->windowBlocks = windowBlocks;
+		xc->windows = (blocks + windowBlocks - 1) / windowBlocks;
+	}
+
+	unsigned long mapBytes = 2 * (unsigned long)blockMapBytes(xc);
+	unsigned long ownerBlocks = xc->memoryBudget > mapBytes ? (xc->memoryBudget - mapBytes) / sizeof(uint) : 0;
+	if(ownerBlocks < MIN_WINDOW)
+		ownerBlocks = MIN_WINDOW;
+	if(ownerBlocks < xc->ownerBlocks)
+		xc->ownerBlocks = ownerBlocks;
+}
+
+// Sweeps the inode table for the window of blocks from windowBase, merges the workers'
+// maps, and compares them against the bitmap and for duplicates
+void sweepWindow(struct xcheck* xc, int threads){
+	uint ninodes = xc->superBlock->ninodes;
+
+	statsBegin(xc, "sweepInodes");
+
+	xc->nsweepers = threads;
+	xc->sweepers = calloc(threads, sizeof(struct sweeper));
+	if(xc->sweepers == NULL){
+		setError(xc, XCHECK_ENOMEM, "could not allocate sweep workers");
+		return;
+	}
+
+	// Give each worker an even share of the inode table
+	int i;
+	for(i = 0; i < threads; i++){
+		xc->sweepers[i].xc = xc;
+		xc->sweepers[i].blockMap = allocBlockMap(xc);
+		xc->sweepers[i].dupMap = allocBlockMap(xc);
+		xc->sweepers[i].next = (uint)((unsigned long)ninodes * i / threads);
+		xc->sweepers[i].end = (uint)((unsigned long)ninodes * (i + 1) / threads);
+		pthread_mutex_init(&xc->sweepers[i].lock, NULL);
+	}
+
+	// Without the maps there is nothing to sweep into
+	if(xc->error != XCHECK_OK){
+		for(i = 0; i < threads; i++){
+			free(xc->sweepers[i].blockMap);
+			free(xc->sweepers[i].dupMap);
+			pthread_mutex_destroy(&xc->sweepers[i].lock);
+		}
+		free(xc->sweepers);
+		xc->sweepers = NULL;
+		return;
+	}
+
+	// A single worker runs on the main thread. The range of a worker which can't be
+	// started is left for the others to steal.
+	int started = 0;
+	if(threads > 1){
+		for(started = 0; started < threads; started++){
+			if(pthread_create(&xc->sweepers[started].thread, NULL, sweepWorker, &xc->sweepers[started]) != 0)
+				break;
+		}
+	}
+
+	if(started == 0)
+		sweepWorker(&xc->sweepers[0]);
+
+	for(i = 0; i < started; i++){
+		pthread_join(xc->sweepers[i].thread, NULL);
+	}
+
+	// Combine the workers' findings
+	sweepMerge(xc, xc->sweepers);
+	statsEnd(xc);
+
+	statsBegin(xc, "compareBitmap");
+	compareBitmap(xc);
+	statsEnd(xc);
+
+	// Find out who owns any duplicated blocks. Their indirect blocks can only be
+	// read once all the addresses are known to be good, or, collecting all findings,
+	// by skipping the addresses that aren't.
+	if((xc->all || xc->sweep.badAddress == ADDR_OK) && firstSet(xc->dupMap, 0, xc->blockMapLen) < xc->blockMapLen){
+		statsBegin(xc, "findDuplicates");
+		findDuplicates(xc);
+		statsEnd(xc);
+	}
+}
+
+// Compares the window's block map against the bitmap, for inodesInBitmapTest and
+// bitmapInInodesTest. The windows are compared in order, so the first mismatch kept
+// for each test is its lowest block.
+void compareBitmap(struct xcheck* xc){
+	long base = xc->windowBase;
+	const uchar* bmap = (uchar*)xc->bmap + base / 8;
+
+	// Blocks past the data region, or past the end of the bitmap, are never in use
+	// in the bitmap. Older images never have their last data block, nblocks, in use.
+	long inUseEnd = newerLayout(xc->superBlock) ? (long)xc->dataEnd + 1 : xc->dataEnd;
+	if(inUseEnd > xc->superBlock->size)
+		inUseEnd = xc->superBlock->size;
+	if(inUseEnd > bitmapEnd(xc))
+		inUseEnd = bitmapEnd(xc);
+	if(inUseEnd < 1)
+		inUseEnd = 1;
+
+	// Blocks referenced by an inode, but not in use in the bitmap. The ranges are
+	// clipped to the window, and made relative to it.
+	long end = base + xc->blockMapLen;
+	long from = (base > 1 ? base : 1) - base;
+	long to = (inUseEnd < end ? inUseEnd : end) - base;
+	long at = from;
+	while(at < to && (at = firstAndNot(xc->blockMap, bmap, at, to)) < to){
+		noteMismatch(xc, XCHECK_RULE_MARKED_FREE, &xc->sweep.markedFree, &xc->sweep.markedFreeBlock, base + at);
+		if(!xc->all)
+			break;
+
+		at++;
+	}
+
+	from = (inUseEnd > base ? inUseEnd : base) - base;
+	to = xc->blockMapLen;
+	at = from;
+	while(at < to && (at = firstSet(xc->blockMap, at, to)) < to){
+		noteMismatch(xc, XCHECK_RULE_MARKED_FREE, &xc->sweep.markedFree, &xc->sweep.markedFreeBlock, base + at);
+		if(!xc->all)
+			break;
+
+		at++;
+	}
+
+	// Blocks marked in use in the bitmap, but not referenced by an inode. Examine the
+	// bits from the data block offset, for the number of data blocks there are. Bits
+	// past nblocks are never in use. The map covers blocks past the end of the image
+	// too, so this range is clipped to the whole window.
+	long last = (long)xc->superBlock->nblocks + xc->dataOffset;
+	if(last > bitmapEnd(xc))
+		last = bitmapEnd(xc);
+
+	end = base + xc->windowBlocks;
+	if(end > mapBlocks(xc))
+		end = mapBlocks(xc);
+
+	from = ((long)xc->dataOffset + 1 > base ? (long)xc->dataOffset + 1 : base) - base;
+	to = (last < end ? last : end) - base;
+	at = from;
+	while(at < to && (at = firstAndNot(bmap, xc->blockMap, at, to)) < to){
+		noteMismatch(xc, XCHECK_RULE_MARKED_USED, &xc->sweep.markedUsed, &xc->sweep.markedUsedBlock, base + at);
+		if(!xc->all)
+			break;
+
+		at++;
+	}
+}
+
+// Records a block where the block map and bitmap disagree. Every one is a finding when
+// collecting all of them. Otherwise only the first is kept, for its test to report.
+void noteMismatch(struct xcheck* xc, uint rule, int* found, uint* first, long block){
+	if(xc->all)
+		addFinding(xc, rule, 0, block, 0);
+
+	if(*found)
+		return;
+
+	*found = 1;
+	*first = block;
+}
+
+// Collects the indirect and first directory blocks held by the useable inodes in
+// [first, last), sorts them and coalesces them into runs, and asks the block source
+// to fetch those runs ahead of the sweep. The sweep visits them in inode order, which
+// is random order on disk.
+void prefetchMetadata(struct xcheck* xc, uint first, uint last){
+	uint perInode = NADDRS - xc->layout->ndirect + 1;
+	uint* blocks = malloc(perInode * (size_t)(last - first) * sizeof(uint) + sizeof(uint));
+	if(blocks == NULL)
+		return;
+
+	// Gather the blocks. Out of range addresses fail the address test, and are never read.
+	uint i, count = 0;
+	for(i = first; i < last; i++){
+		if(!useableType(xc->inodes[i].type))
+			continue;
+
+		uint* refBlocks = xc->inodes[i].addrs;
+		uint j;
+		for(j = xc->layout->ndirect; j < NADDRS; j++){
+			if(refBlocks[j] != 0 && refBlocks[j] < xc->superBlock->size)
+				blocks[count++] = refBlocks[j];
+		}
+
+		if(xc->inodes[i].type == T_DIR && refBlocks[0] != 0 && refBlocks[0] < xc->superBlock->size)
+			blocks[count++] = refBlocks[0];
+	}
+
+	qsort(blocks, count, sizeof(uint), compareBlocks);
+
+	// Issue one request per run of nearby blocks
+	uint start = 0;
+	for(i = 1; i <= count; i++){
+		if(i < count && blocks[i] - blocks[i - 1] <= PREFETCH_GAP)
+			continue;
+
+		xc->source->advise(xc, blocks[start], blocks[i - 1] - blocks[start] + 1, ADVISE_WILLNEED);
+		start = i;
+	}
+
+	free(blocks);
+}
+
+// Orders block numbers for qsort
+int compareBlocks(const void* a, const void* b){
+	uint x = *(const uint*)a;
+	uint y = *(const uint*)b;
+
+	return (x > y) - (x < y);
+}
+
+// Visits chunks of inodes until there is no work left to take or steal
+void* sweepWorker(void* arg){
+	struct sweeper* self = arg;
+	struct xcheck* xc = self->xc;
+
+	uint start, end, i;
+	while(sweepTake(xc, self, &start, &end)){
+		for(i = start; i < end; i++){
+			sweepInode(xc, self, i);
+		}
+
+		if(xc->stats)
+			atomic_fetch_add_explicit(&xc->inodesVisited, end - start, memory_order_relaxed);
+	}
+
+	return NULL;
+}
+
+// Takes the next chunk of inodes [start, end) for a worker to visit. If its own range is
+// empty, the worker steals the upper half of the largest remaining range. Returns 0 once
+// there is no work left.
+int sweepTake(struct xcheck* xc, struct sweeper* self, uint* start, uint* end){
+	while(1){
+		// Take a chunk from our own range
+		pthread_mutex_lock(&self->lock);
+		if(self->next < self->end){
+			*start = self->next;
+			*end = self->end - self->next > SWEEP_CHUNK ? self->next + SWEEP_CHUNK : self->end;
+			self->next = *end;
+			pthread_mutex_unlock(&self->lock);
+			return 1;
+		}
+		pthread_mutex_unlock(&self->lock);
+
+		// Find the worker with the most work left
+		struct sweeper* victim = NULL;
+		uint most = 0;
+		int i;
+		for(i = 0; i < xc->nsweepers; i++){
+			pthread_mutex_lock(&xc->sweepers[i].lock);
+			uint left = xc->sweepers[i].end - xc->sweepers[i].next;
+			if(xc->sweepers[i].next < xc->sweepers[i].end && left > most){
+				most = left;
+				victim = &xc->sweepers[i];
+			}
+			pthread_mutex_unlock(&xc->sweepers[i].lock);
+		}
+
+		// Nothing left anywhere, so the sweep is done
+		if(victim == NULL)
+			return 0;
+
+		// Steal the upper half of the victim's range. It may have shrunk since we
+		// looked, in which case we look again.
+		pthread_mutex_lock(&victim->lock);
+		uint left = victim->next < victim->end ? victim->end - victim->next : 0;
+		uint stolenStart = victim->end - left / 2;
+		uint stolenEnd = victim->end;
+		if(left > SWEEP_CHUNK)
+			victim->end = stolenStart;
+		pthread_mutex_unlock(&victim->lock);
+
+		if(left <= SWEEP_CHUNK){
+			// Too little to split, so just take the victim's last chunk
+			if(left == 0)
+				continue;
+
+			pthread_mutex_lock(&victim->lock);
+			if(victim->next >= victim->end){
+				pthread_mutex_unlock(&victim->lock);
+				continue;
+			}
+			*start = victim->next;
+			*end = victim->end;
+			victim->next = victim->end;
+			pthread_mutex_unlock(&victim->lock);
+			return 1;
+		}
+
+		// Make the stolen range our own
+		pthread_mutex_lock(&self->lock);
+		self->next = stolenStart;
+		self->end = stolenEnd;
+		pthread_mutex_unlock(&self->lock);
+	}
+}
+
+// Combines the results of all the sweep workers into sweep, blockMap and dupMap. Each
+// failure kept is the one with the lowest inode number, as a serial sweep would find
+// it. A block is duplicated if any worker saw it twice, or two workers saw it once.
+// The per-inode results are the same for every window, so are taken from the first.
+void sweepMerge(struct xcheck* xc, struct sweeper* workers){
+	int first = xc->windowBase == 0;
+	if(first){
+		memset(&xc->sweep, 0, sizeof(xc->sweep));
+	}
+
+	xc->blockMap = workers[0].blockMap;
+	xc->dupMap = workers[0].dupMap;
+	xc->blockMapLen = xc->superBlock->size > xc->windowBase ? xc->superBlock->size - xc->windowBase : 0;
+	if(xc->blockMapLen > xc->windowBlocks)
+		xc->blockMapLen = xc->windowBlocks;
+
+	int i;
+	for(i = 0; i < xc->nsweepers; i++){
+		struct sweeper* w = &workers[i];
+		struct sweepResult* result = &w->result;
+
+		if(!first)
+			goto maps;
+
+
+		if(result->badInode && (!xc->sweep.badInode || result->badInodeInum < xc->sweep.badInodeInum)){
+			xc->sweep.badInode = 1;
+			xc->sweep.badInodeInum = result->badInodeInum;
+		}
+
+		if(result->badDirectory && (!xc->sweep.badDirectory || result->badDirectoryInum < xc->sweep.badDirectoryInum)){
+			xc->sweep.badDirectory = 1;
+			xc->sweep.badDirectoryInum = result->badDirectoryInum;
+		}
+
+		if(result->badAddress != ADDR_OK &&
+		   (xc->sweep.badAddress == ADDR_OK || result->badAddressInum < xc->sweep.badAddressInum)){
+			xc->sweep.badAddress = result->badAddress;
+			xc->sweep.badAddressInum = result->badAddressInum;
+		}
+
+	maps:
+		// Fold the worker's maps into the first one
+		if(i > 0){
+			uint j, bytes = blockMapBytes(xc);
+			for(j = 0; j < bytes; j++){
+				xc->dupMap[j] |= w->dupMap[j] | (xc->blockMap[j] & w->blockMap[j]);
+				xc->blockMap[j] |= w->blockMap[j];
+			}
+			free(w->blockMap);
+			free(w->dupMap);
+		}
+
+		pthread_mutex_destroy(&w->lock);
+	}
+
+	free(workers);
+	xc->sweepers = NULL;
+}
+
+// Applies the per-inode rules to a single inode, recording failures in the worker's results
+void sweepInode(struct xcheck* xc, struct sweeper* self, uint inum){
+	struct sweepResult* result = &self->result;
+	short type = xc->index.type[inum];
+
+	// The per-inode rules are the same in every window, so are only recorded in the
+	// first. Later windows only mark blocks.
+	int first = xc->windowBase == 0;
+
+	// An unrecognized type fails the inode test, and nothing else applies to it
+	if(!validInode(type)){
+		if(!result->badInode || inum < result->badInodeInum){
+			result->badInode = 1;
+			result->badInodeInum = inum;
+		}
+
+		if(xc->all && first)
+			addFinding(xc, XCHECK_RULE_BAD_INODE, inum, 0, 0);
+		return;
+	}
+
+	// Only examine useable inodes further
+	if(!useableType(type))
+		return;
+
+	// Once an inode has a bad address the checker stops at the address test, so
+	// the rules after it no longer matter for higher inodes. Lower inodes may still
+	// arrive out of order from stolen ranges, and must be checked.
+	if(!xc->all && result->badAddress != ADDR_OK && inum > result->badAddressInum)
+		return;
+
+	// The addresses must be in range before any of the blocks can be read
+	int addrStatus = validAddresses(xc, inum);
+	if(addrStatus != ADDR_OK){
+		if(result->badAddress == ADDR_OK || inum < result->badAddressInum){
+			result->badAddress = addrStatus;
+			result->badAddressInum = inum;
+		}
+
+		// When collecting all findings, the rest of the rules still apply to the
+		// addresses that are in range
+		if(xc->all)
+			markAddresses(xc, self, inum);
+		return;
+	}
+
+	// Directories must be properly formatted
+	if(first && type == T_DIR && !validDirect(xc, inum)){
+		if(!result->badDirectory || inum < result->badDirectoryInum){
+			result->badDirectory = 1;
+			result->badDirectoryInum = inum;
+		}
+
+		if(xc->all)
+			addFinding(xc, XCHECK_RULE_BAD_DIRECTORY, inum, 0, 0);
+	}
+
+	// Record the direct addresses, the indirect block itself, and the blocks it
+	// lists in the block map
+	uint length;
+	uint* row = inodeAddrs(xc, inum, &length);
+
+	uint i;
+	for(i = 0; i < length; i++){
+		markBlock(xc, self, row[i]);
+	}
+}
+
+// Finds the owners of the blocks in the window's dupMap, ownerBlocks of them at a time.
+// A repeated reference counts against the direct or indirect test depending on where
+// it appears. The first repeat of each kind is kept for the report.
+void findDuplicates(struct xcheck* xc){
+	// First inode number plus one to reference each block, for duplicated blocks only
+	uint* owner = malloc(xc->ownerBlocks * sizeof(uint));
+	if(owner == NULL){
+		setError(xc, XCHECK_ENOMEM, "could not allocate block owners");
+		return;
+	}
+
+	// Skip the parts of the window with nothing duplicated
+	for(xc->ownerBase = 0; xc->ownerBase < xc->blockMapLen; xc->ownerBase = xc->ownerEnd){
+		xc->ownerEnd = xc->blockMapLen - xc->ownerBase > xc->ownerBlocks ? xc->ownerBase + xc->ownerBlocks : xc->blockMapLen;
+		if(firstSet(xc->dupMap, xc->ownerBase, xc->ownerEnd) == xc->ownerEnd)
+			continue;
+
+		memset(owner, 0, xc->ownerBlocks * sizeof(uint));
+		claimOwners(xc, owner);
+	}
+
+	free(owner);
+}
+
+// Walks the inodes in order, claiming the blocks between ownerBase and ownerEnd of the
+// window
+void claimOwners(struct xcheck* xc, uint* owner){
+	struct inodeIndex* index = &xc->index;
+	if(xc->stats)
+		atomic_fetch_add_explicit(&xc->inodesVisited, index->nused, memory_order_relaxed);
+
+	// Iterate through the useable inodes
+	uint k;
+	for(k = 0; k < index->nused; k++){
+		uint i = index->used[k];
+
+		// Claim the inode's own addresses, and those its indirect blocks list. Only
+		// the addresses in range were marked by the sweep.
+		uint length;
+		uint* row = inodeAddrs(xc, i, &length);
+
+		uint j;
+		for(j = 0; j < length; j++){
+			if(!addressInRange(xc, row[j]))
+				continue;
+
+			if(j < NADDRS)
+				claimBlock(xc, owner, row[j], i, 0, j);
+			else
+				claimBlock(xc, owner, row[j], i, 1, j - NADDRS);
+		}
+	}
+}
+
+// Records inode inum's reference to a block in owner, if the block is duplicated. A
+// reference to an already owned block is a repeat, reported as a direct or indirect
+// duplicate. Slot is where the reference is among the inode's addresses, which orders
+// repeats found in different windows as a single walk would find them.
+void claimBlock(struct xcheck* xc, uint* owner, uint blockIndex, uint inum, int isIndirect, uint slot){
+	// Only duplicated blocks in the part of the window being claimed are of interest
+	if(blockIndex == 0 || blockIndex < xc->windowBase)
+		return;
+
+	uint at = blockIndex - xc->windowBase;
+	if(at < xc->ownerBase || at >= xc->ownerEnd)
+		return;
+
+	if(!(xc->dupMap[at / 8] & (1 << (at % 8))))
+		return;
+
+	// The first reference owns the block
+	uint* first = &owner[at - xc->ownerBase];
+	if(*first == 0){
+		*first = inum + 1;
+		return;
+	}
+
+	// Otherwise this reference repeats it
+	if(xc->all)
+		addFinding(xc, isIndirect ? XCHECK_RULE_DUP_INDIRECT : XCHECK_RULE_DUP_DIRECT, inum, blockIndex, *first - 1);
+
+	int* found = isIndirect ? &xc->sweep.dupIndirect : &xc->sweep.dupDirect;
+	struct dupBlock* dup = isIndirect ? &xc->dupIndirectBlock : &xc->dupDirectBlock;
+	if(*found && (inum > dup->repeatInum || (inum == dup->repeatInum && slot > dup->slot)))
+		return;
+
+	*found = 1;
+	dup->block = blockIndex;
+	dup->firstInum = *first - 1;
+	dup->repeatInum = inum;
+	dup->slot = slot;
+}
+
+// Checks that no block is referenced more than once across all in-use inodes, where
+// the repeated reference is in an indirect block.
+int indirectAddressTest(struct xcheck* xc){
+	if(xc->sweep.dupIndirect && !xc->all)
+		addFinding(xc, XCHECK_RULE_DUP_INDIRECT, xc->dupIndirectBlock.repeatInum,
+			xc->dupIndirectBlock.block, xc->dupIndirectBlock.firstInum);
+
+	return !xc->sweep.dupIndirect;
+}
+
+// Checks that no block is referenced more than once across all in-use inodes, where
+// the repeated reference is a direct address.
+int directAddressTest(struct xcheck* xc){
+	if(xc->sweep.dupDirect && !xc->all)
+		addFinding(xc, XCHECK_RULE_DUP_DIRECT, xc->dupDirectBlock.repeatInum,
+			xc->dupDirectBlock.block, xc->dupDirectBlock.firstInum);
+
+	return !xc->sweep.dupDirect;
+}
+
+// Examines all directories, and determines that they are properly formatted
+int directoryTest(struct xcheck* xc){
+	if(xc->sweep.badDirectory && !xc->all)
+		addFinding(xc, XCHECK_RULE_BAD_DIRECTORY, xc->sweep.badDirectoryInum, 0, 0);
+
+	return !xc->sweep.badDirectory;
+}
+
+// Examines the root directory, and returns 1 if it's data is correct. Return 0 otherwise.
+int rootTest(struct xcheck* xc){
+	if(validRoot(xc))
+		return 1;
+
+	addFinding(xc, XCHECK_RULE_BAD_ROOT, ROOT_INO, 0, 0);
+	return 0;
+}
+
+// Returns 1 if the root inode and the first block of the root directory are correct
+int validRoot(struct xcheck* xc){
+	// The inode table must hold the root
+	if(ROOT_INO >= xc->superBlock->ninodes)
+		return 0;
+
+	// Make sure the root inode is usable
+	if(!useableType(xc->index.type[ROOT_INO]))
+		return 0;
+
+	// The root shouldn't be empty
+	if(xc->index.size[ROOT_INO] == 0)
+		return 0;
+
+	// The root inode should only use valid addresses
+	if(validAddresses(xc, ROOT_INO) != ADDR_OK)
+		return 0;
+
+	// The first address of the root inode shouldn't be empty
+	uint length;
+	uint* row = inodeAddrs(xc, ROOT_INO, &length);
+	if(row[0] == 0)
+		return 0;
+
+	// Load the root directory entry from the disk
+	struct block b;
+	bread(xc, row[0], &b);
+	struct dirent* root = (struct dirent*)b.data;
+
+	// The '..' entry in the root directory should be equal to our ROOT_INO number of '1'
+	if(root[1].inum != ROOT_INO)
+		return 0;
+
+	// Root has passed all tests.
+	return 1;
+}
+
+// Returns 1 if all inodes are valid. 0 otherwise.
+int inodesValidTest(struct xcheck* xc){
+	if(xc->sweep.badInode && !xc->all)
+		addFinding(xc, XCHECK_RULE_BAD_INODE, xc->sweep.badInodeInum, 0, 0);
+
+	return !xc->sweep.badInode;
+}
+
+// Returns 1 if all addresses referenced by useable inodes are valid. Returns 0 otherwise.
+int inodesAddressTest(struct xcheck* xc){
+	if(xc->sweep.badAddress != ADDR_OK && !xc->all)
+		addFinding(xc, xc->sweep.badAddress == ADDR_BAD_DIRECT ? XCHECK_RULE_BAD_DIRECT : XCHECK_RULE_BAD_INDIRECT,
+			xc->sweep.badAddressInum, 0, 0);
+
+	return xc->sweep.badAddress == ADDR_OK;
+}
+
+// Returns 1 if all blocks in the bitmap marked as in-use are referred to by some inode.
+// If not, returns 0
+int bitmapInInodesTest(struct xcheck* xc){
+	if(xc->sweep.markedUsed && !xc->all)
+		addFinding(xc, XCHECK_RULE_MARKED_USED, 0, xc->sweep.markedUsedBlock, 0);
+
+	return !xc->sweep.markedUsed;
+}
+
+// Returns 1 if for all in-use inodes, each block in use is also marked in-use by the
+// bitmap. Returns 0 if an inode is using a block which is not marked as in-use by the
+// bitmap.
+int inodesInBitmapTest(struct xcheck* xc){
+	if(xc->sweep.markedFree && !xc->all)
+		addFinding(xc, XCHECK_RULE_MARKED_FREE, 0, xc->sweep.markedFreeBlock, 0);
+
+	return !xc->sweep.markedFree;
+}
+
+// ***
+// *
+// *   Quick check functions
+// *
+// ***
+
+// The quick checks read only the super block, the inode table and the bitmap, never
+// an indirect or directory block.
+
+// Returns 1 if every inode has a known type, 0 otherwise. The inode table is scanned
+// directly rather than swept.
+int inodeTypesTest(struct xcheck* xc){
+	int passed = 1;
+
+	uint i;
+	for(i = 0; i < xc->superBlock->ninodes; i++){
+		if(validInode(xc->index.type[i]))
+			continue;
+
+		passed = 0;
+		addFinding(xc, XCHECK_RULE_BAD_INODE, i, 0, 0);
+		if(!xc->all)
+			break;
+	}
+
+	if(xc->stats)
+		xc->inodesVisited += i;
+
+	return passed;
+}
+
+// Returns 1 if the root inode looks like the root directory, as far as can be told
+// without reading its blocks, 0 otherwise
+int rootInodeTest(struct xcheck* xc){
+	int passed = ROOT_INO < xc->superBlock->ninodes && xc->index.type[ROOT_INO] == T_DIR &&
+		xc->index.size[ROOT_INO] != 0;
+
+	// Only the root's own addresses are decoded at the quick level
+	uint length = 0;
+	uint* row = passed ? inodeAddrs(xc, ROOT_INO, &length) : NULL;
+	if(passed && row[0] == 0)
+		passed = 0;
+
+	uint i;
+	for(i = 0; i < length && passed; i++){
+		if(row[i] != 0 && !addressInRange(xc, row[i]))
+			passed = 0;
+	}
+
+	if(!passed)
+		addFinding(xc, XCHECK_RULE_BAD_ROOT, ROOT_INO, 0, 0);
+
+	return passed;
+}
+
+// Returns 1 if the bitmap marks as many data blocks in use as the in-use inodes hold,
+// 0 otherwise. A consistent image passes, but blocks marked in the wrong places can
+// balance out.
+int bitmapCountTest(struct xcheck* xc){
+	unsigned long held = 0;
+
+	uint i;
+	for(i = 0; i < xc->index.nused; i++){
+		held += inodeBlocks(xc, xc->index.used[i]);
+	}
+
+	long marked = countSet((uchar*)xc->bmap, xc->dataOffset, bitmapEnd(xc));
+	if((unsigned long)marked == held)
+		return 1;
+
+	addFinding(xc, XCHECK_RULE_BITMAP_COUNT, 0, 0, 0);
+	return 0;
+}
+
+// Returns the number of blocks an inode holds: its direct blocks, its indirect block
+// with as many blocks as its size needs past the direct ones, and its doubly indirect
+// block with the indirect blocks it needs for the rest. The indirect blocks themselves
+// aren't read.
+unsigned long inodeBlocks(struct xcheck* xc, uint inum){
+	uint length;
+	uint* row = inodeAddrs(xc, inum, &length);
+	uint ndirect = xc->layout->ndirect;
+	uint nindirect = xc->blockSize / sizeof(uint);
+	unsigned long held = 0;
+
+	uint i;
+	for(i = 0; i < ndirect; i++){
+		if(row[i] != 0)
+			held++;
+	}
+
+	// Count as if every indirect block were in range
+	uint size = xc->index.size[inum];
+	uint needed = size > ndirect * xc->blockSize ? (size - ndirect * xc->blockSize + xc->blockSize - 1) / xc->blockSize : 0;
+	if(row[ndirect] != 0)
+		held += 1 + (needed < nindirect ? needed : nindirect);
+
+	if(xc->layout->depth == 2 && row[ndirect + 1] != 0 && needed > nindirect){
+		unsigned long doubly = needed - nindirect < nindirect * nindirect ? needed - nindirect : nindirect * nindirect;
+		held += 1 + doubly + (doubly + nindirect - 1) / nindirect;
+	}
+
+	return held;
+}
+
+// ***
+// *
+// *   Directory tree functions
+// *
+// ***
+
+// Walks the directory tree from the root, counting the entries that refer to each inode,
+// and noting each directory's parent and '..'. The directories the walk can't reach are
+// scanned afterwards, so their entries count too. Every directory entry is visited once.
+// The walk is split between the given number of threads, and finds the same no matter
+// how many there are.
+void walkTree(struct xcheck* xc, int threads){
+	uint ninodes = xc->superBlock->ninodes;
+
+	xc->walk.refs = calloc(ninodes, sizeof(atomic_uint));
+	xc->walk.parent = calloc(ninodes, sizeof(atomic_uint));
+	xc->walk.dotdot = calloc(ninodes, sizeof(uint));
+	xc->walk.reached = calloc(ninodes, sizeof(atomic_uchar));
+	xc->walkers = calloc(threads, sizeof(struct walker));
+	if(xc->walk.refs == NULL || xc->walk.parent == NULL || xc->walk.dotdot == NULL ||
+	   xc->walk.reached == NULL || xc->walkers == NULL){
+		setError(xc, XCHECK_ENOMEM, "could not allocate directory tree");
+		free(xc->walkers);
+		xc->walkers = NULL;
+		return;
+	}
+
+	xc->nwalkers = threads;
+	xc->walk.badName = NAME_NONE;
+	xc->walk.dupName = NAME_NONE;
+	int i;
+	for(i = 0; i < threads; i++){
+		xc->walkers[i].xc = xc;
+		pthread_mutex_init(&xc->walkers[i].lock, NULL);
+	}
+
+	// The walk starts at the root
+	if(ROOT_INO < ninodes && xc->index.type[ROOT_INO] == T_DIR){
+		xc->walk.reached[ROOT_INO] = 1;
+		xc->walk.parent[ROOT_INO] = ROOT_INO;
+		walkPush(xc, &xc->walkers[0], ROOT_INO);
+	}
+
+	// A single worker runs on the main thread. The root is left for the others to
+	// steal if its worker can't be started.
+	int started = 0;
+	if(threads > 1){
+		for(started = 0; started < threads; started++){
+			if(pthread_create(&xc->walkers[started].thread, NULL, walkWorker, &xc->walkers[started]) != 0)
+				break;
+		}
+	}
+
+	if(started == 0)
+		walkWorker(&xc->walkers[0]);
+
+	for(i = 0; i < started; i++){
+		pthread_join(xc->walkers[i].thread, NULL);
+	}
+
+	for(i = 0; i < threads; i++){
+		free(xc->walkers[i].stack);
+		nameFree(&xc->walkers[i].names);
+		pthread_mutex_destroy(&xc->walkers[i].lock);
+	}
+	free(xc->walkers);
+	xc->walkers = NULL;
+
+	// Then count the entries of the directories cut off from the root
+	struct nameTable names;
+	memset(&names, 0, sizeof(names));
+	uint j;
+	for(j = 0; j < ninodes && xc->error == XCHECK_OK; j++){
+		if(xc->index.type[j] == T_DIR && !xc->walk.reached[j])
+			walkDirectory(xc, j, NULL, &names);
+	}
+	nameFree(&names);
+}
+
+// Scans directories until none are left on any worker's stack, or being scanned
+void* walkWorker(void* arg){
+	struct walker* self = arg;
+	struct xcheck* xc = self->xc;
+
+	uint inum;
+	while(1){
+		if(walkTake(xc, self, &inum)){
+			walkDirectory(xc, inum, self, &self->names);
+			atomic_fetch_sub_explicit(&xc->walkPending, 1, memory_order_acq_rel);
+		} else if(atomic_load_explicit(&xc->walkPending, memory_order_acquire) == 0){
+			// Nothing is queued, and nothing being scanned can add more
+			break;
+		} else{
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+// Pushes a directory onto a worker's stack
+void walkPush(struct xcheck* xc, struct walker* self, uint inum){
+	atomic_fetch_add_explicit(&xc->walkPending, 1, memory_order_relaxed);
+
+	pthread_mutex_lock(&self->lock);
+
+	// Make room, reusing the space stolen from the bottom first
+	if(self->top == self->cap){
+		if(self->bottom > 0){
+			memmove(self->stack, self->stack + self->bottom, (self->top - self->bottom) * sizeof(uint));
+			self->top -= self->bottom;
+			self->bottom = 0;
+		} else{
+			uint cap = self->cap == 0 ? 64 : self->cap * 2;
+			uint* grown = realloc(self->stack, cap * sizeof(uint));
+			if(grown == NULL){
+				// The directory is dropped, so the walk has failed
+				setError(xc, XCHECK_ENOMEM, "could not allocate directory stack");
+				atomic_fetch_sub_explicit(&xc->walkPending, 1, memory_order_relaxed);
+				pthread_mutex_unlock(&self->lock);
+				return;
+			}
+
+			self->stack = grown;
+			self->cap = cap;
+		}
+	}
+
+	self->stack[self->top++] = inum;
+	pthread_mutex_unlock(&self->lock);
+}
+
+// Takes the next directory for a worker to scan, from the top of its own stack, or
+// else from the bottom of another's, where the oldest and largest subtrees wait.
+// Returns 0 if every stack is empty.
+int walkTake(struct xcheck* xc, struct walker* self, uint* inum){
+	// Take from our own stack
+	pthread_mutex_lock(&self->lock);
+	if(self->bottom < self->top){
+		*inum = self->stack[--self->top];
+		pthread_mutex_unlock(&self->lock);
+		return 1;
+	}
+	pthread_mutex_unlock(&self->lock);
+
+	// Steal from the first other worker with something on its stack
+	int i;
+	for(i = 0; i < xc->nwalkers; i++){
+		struct walker* victim = &xc->walkers[i];
+		if(victim == self)
+			continue;
+
+		pthread_mutex_lock(&victim->lock);
+		if(victim->bottom < victim->top){
+			*inum = victim->stack[victim->bottom++];
+			pthread_mutex_unlock(&victim->lock);
+			return 1;
+		}
+		pthread_mutex_unlock(&victim->lock);
+	}
+
+	return 0;
+}
+
+// Scans the entries of directory inum. If a worker is given, the directory is reachable,
+// and the worker pushes the directories it is the first to reach. The names of the
+// entries are checked as they go into names, which is emptied first.
+void walkDirectory(struct xcheck* xc, uint inum, struct walker* self, struct nameTable* names){
+	uint ninodes = xc->superBlock->ninodes;
+	uint perBlock = xc->blockSize / sizeof(struct dirent);
+	uint entries = directoryEntries(xc, xc->index.size[inum]);
+
+	// There are no more entries than the row has blocks for
+	unsigned long rowEntries = ((unsigned long)xc->layout->ndirect + xc->index.listed[inum]) * perBlock;
+	if(entries > rowEntries)
+		entries = rowEntries;
+
+	if(xc->stats)
+		atomic_fetch_add_explicit(&xc->inodesVisited, 1, memory_order_relaxed);
+
+	nameReset(names);
+
+	// Visit each block holding entries
+	uint first;
+	for(first = 0; first < entries; first += perBlock){
+		struct block b;
+		uint address = directoryBlock(xc, inum, first / perBlock, &b);
+		if(address == 0)
+			continue;
+
+		struct dirent* entry = (struct dirent*)b.data;
+		uint count = entries - first < perBlock ? entries - first : perBlock;
+
+		uint i;
+		for(i = 0; i < count; i++){
+			uint child = entry[i].inum;
+			if(child == 0)
+				continue;
+
+			// Each name must be well formed, and differ from the others of the directory
+			if(nameGrow(names)){
+				int added = NAME_KERNEL(names, &entry[i]);
+				if(added == NAME_BAD)
+					noteName(xc, &xc->walk.badName, XCHECK_RULE_BAD_NAME, inum, address);
+				else if(added == NAME_REPEATED)
+					noteName(xc, &xc->walk.dupName, XCHECK_RULE_DUP_NAME, inum, address);
+			} else{
+				setError(xc, XCHECK_ENOMEM, "could not allocate directory names");
+			}
+
+			// '.' and '..' aren't links
+			if(strncmp(entry[i].name, ".", DIRSIZ) == 0)
+				continue;
+
+			if(strncmp(entry[i].name, "..", DIRSIZ) == 0){
+				xc->walk.dotdot[inum] = child;
+				continue;
+			}
+
+			// An entry past the inode table can only refer to a free inode
+			if(child >= ninodes || xc->index.type[child] == T_UNALLOC){
+				uint lowest = atomic_load_explicit(&xc->walk.referencedFree, memory_order_relaxed);
+				while((lowest == 0 || child < lowest) &&
+				      !atomic_compare_exchange_weak_explicit(&xc->walk.referencedFree, &lowest, child,
+				                                             memory_order_relaxed, memory_order_relaxed));
+
+				if(xc->all)
+					addFinding(xc, XCHECK_RULE_REFERENCED_FREE, child, 0, 0);
+				continue;
+			}
+
+			atomic_fetch_add_explicit(&xc->walk.refs[child], 1, memory_order_relaxed);
+
+			if(self == NULL || xc->index.type[child] != T_DIR)
+				continue;
+
+			// Keep the lowest parent, so the result doesn't depend on the order the
+			// directories were scanned in
+			uint parent = atomic_load_explicit(&xc->walk.parent[child], memory_order_relaxed);
+			while((parent == 0 || inum < parent) &&
+			      !atomic_compare_exchange_weak_explicit(&xc->walk.parent[child], &parent, inum,
+			                                             memory_order_relaxed, memory_order_relaxed));
+
+			// Push the directories reached for the first time
+			if(!atomic_exchange_explicit(&xc->walk.reached[child], 1, memory_order_relaxed))
+				walkPush(xc, self, child);
+		}
+	}
+}
+
+// Reads the nth data block of directory inum into b, returning its address. Returns 0
+// if there is no such block, or its address is out of range.
+uint directoryBlock(struct xcheck* xc, uint inum, uint nth, struct block* b){
+	uint length;
+	uint* row = inodeAddrs(xc, inum, &length);
+
+	// Later blocks were listed by the indirect blocks, if they were in range
+	uint ndirect = xc->layout->ndirect;
+	uint slot = nth;
+	if(nth >= ndirect){
+		if(nth - ndirect >= xc->index.listed[inum])
+			return 0;
+		slot = NADDRS + nth - ndirect;
+	}
+	if(slot >= length)
+		return 0;
+
+	uint address = row[slot];
+	if(address == 0 || !addressInRange(xc, address))
+		return 0;
+
+	bread(xc, address, b);
+	return address;
+}
+
+// Records an entry of directory inum, in the given block, which breaks a name rule.
+// Only the lowest directory and block are kept for the test to report, unless every
+// finding is collected.
+void noteName(struct xcheck* xc, _Atomic uint64_t* lowest, uint rule, uint inum, uint block){
+	uint64_t key = (uint64_t)inum << 32 | block;
+	uint64_t seen = atomic_load_explicit(lowest, memory_order_relaxed);
+	while(key < seen && !atomic_compare_exchange_weak_explicit(lowest, &seen, key,
+	                                                          memory_order_relaxed, memory_order_relaxed));
+
+	if(xc->all)
+		addFinding(xc, rule, inum, block, 0);
+}
+
+// Returns 1 if every in-use inode is referred to by some directory entry. Returns 0
+// otherwise. The root needs no entry.
+int inodesReferencedTest(struct xcheck* xc){
+	int passed = 1;
+
+	uint i;
+	for(i = ROOT_INO + 1; i < xc->superBlock->ninodes; i++){
+		if(!useableType(xc->index.type[i]) || xc->walk.refs[i] > 0)
+			continue;
+
+		passed = 0;
+		addFinding(xc, XCHECK_RULE_UNREFERENCED, i, 0, 0);
+		if(!xc->all)
+			break;
+	}
+
+	return passed;
+}
+
+// Returns 1 if every directory entry refers to an in-use inode. Returns 0 otherwise.
+// The entries were checked by the walk.
+int referencesAllocatedTest(struct xcheck* xc){
+	if(xc->walk.referencedFree != 0 && !xc->all)
+		addFinding(xc, XCHECK_RULE_REFERENCED_FREE, xc->walk.referencedFree, 0, 0);
+
+	return !xc->walk.referencedFree;
+}
+
+// Returns 1 if each file's link count matches the number of directory entries referring
+// to it. Returns 0 otherwise.
+int referenceCountTest(struct xcheck* xc){
+	int passed = 1;
+
+	uint i;
+	for(i = 0; i < xc->superBlock->ninodes; i++){
+		if(xc->index.type[i] != T_FILE || (uint)xc->index.nlink[i] == xc->walk.refs[i])
+			continue;
+
+		passed = 0;
+		addFinding(xc, XCHECK_RULE_BAD_REFCOUNT, i, 0, 0);
+		if(!xc->all)
+			break;
+	}
+
+	return passed;
+}
+
+// Returns 1 if no directory has more than one entry referring to it, other than its
+// '.' and '..' entries. Returns 0 otherwise.
+int directoryOnceTest(struct xcheck* xc){
+	int passed = 1;
+
+	uint i;
+	for(i = 0; i < xc->superBlock->ninodes; i++){
+		if(xc->index.type[i] != T_DIR || xc->walk.refs[i] <= 1)
+			continue;
+
+		passed = 0;
+		addFinding(xc, XCHECK_RULE_DIR_ONCE, i, 0, 0);
+		if(!xc->all)
+			break;
+	}
+
+	return passed;
+}
+
+// Returns 1 if the '..' entry of each reachable directory refers to the directory it
+// was reached from, the lowest numbered if there are several. Returns 0 otherwise.
+int parentDirectoryTest(struct xcheck* xc){
+	int passed = 1;
+
+	uint i;
+	for(i = 0; i < xc->superBlock->ninodes; i++){
+		if(!xc->walk.reached[i] || xc->walk.dotdot[i] == xc->walk.parent[i])
+			continue;
+
+		passed = 0;
+		addFinding(xc, XCHECK_RULE_PARENT_MISMATCH, i, 0, 0);
+		if(!xc->all)
+			break;
+	}
+
+	return passed;
+}
+
+// Returns 1 if every directory can be reached from the root. Returns 0 otherwise. A
+// directory only reachable through a cycle is not.
+int directoryAccessibleTest(struct xcheck* xc){
+	int passed = 1;
+
+	uint i;
+	for(i = 0; i < xc->superBlock->ninodes; i++){
+		if(xc->index.type[i] != T_DIR || xc->walk.reached[i])
+			continue;
+
+		passed = 0;
+		addFinding(xc, XCHECK_RULE_INACCESSIBLE, i, 0, 0);
+		if(!xc->all)
+			break;
+	}
+
+	return passed;
+}
+
+// Returns 1 if every directory entry in use has a name which is not empty, and is
+// padded with zeros after its end. Returns 0 otherwise. The names were checked by the
+// walk, in every block of every directory.
+int entryNamesTest(struct xcheck* xc){
+	uint64_t lowest = xc->walk.badName;
+	if(lowest != NAME_NONE && !xc->all)
+		addFinding(xc, XCHECK_RULE_BAD_NAME, lowest >> 32, (uint)lowest, 0);
+
+	return lowest == NAME_NONE;
+}
+
+// Returns 1 if no directory has two entries in use with the same name. Returns 0
+// otherwise. The names were compared by the walk.
+int duplicateNamesTest(struct xcheck* xc){
+	uint64_t lowest = xc->walk.dupName;
+	if(lowest != NAME_NONE && !xc->all)
+		addFinding(xc, XCHECK_RULE_DUP_NAME, lowest >> 32, (uint)lowest, 0);
+
+	return lowest == NAME_NONE;
+}
+
+// ***
+// *
+// *   Directory name functions
+// *
+// ***
+
+// Makes room in a name table for one more name, keeping it at most half full. The
+// names are rehashed into the larger table. Returns 0 if memory ran out.
+int nameGrow(struct nameTable* names){
+	if((unsigned long)(names->count + 1) * 2 <= names->cap)
+		return 1;
+
+	uint cap = names->cap == 0 ? 64 : names->cap * 2;
+	uchar* slots;
+	uint* stamps = calloc(cap, sizeof(uint));
+	if(cap < names->cap || stamps == NULL || posix_memalign((void**)&slots, 16, (size_t)cap * sizeof(struct dirent)) != 0){
+		free(stamps);
+		return 0;
+	}
+
+	uint i;
+	for(i = 0; i < names->cap; i++){
+		if(names->stamps[i] != names->generation)
+			continue;
+
+		uint at = nameHash(&names->slots[(size_t)i * sizeof(struct dirent)]) & (cap - 1);
+		while(stamps[at] == names->generation)
+			at = (at + 1) & (cap - 1);
+		memcpy(&slots[(size_t)at * sizeof(struct dirent)], &names->slots[(size_t)i * sizeof(struct dirent)], sizeof(struct dirent));
+		stamps[at] = names->generation;
+	}
+
+	free(names->slots);
+	free(names->stamps);
+	names->slots = slots;
+	names->stamps = stamps;
+	names->cap = cap;
+	return 1;
+}
+
+// Empties a name table for the next directory
+void nameReset(struct nameTable* names){
+	names->count = 0;
+	if(++names->generation == 0){
+		if(names->stamps != NULL)
+			memset(names->stamps, 0, names->cap * sizeof(uint));
+		names->generation = 1;
+	}
+}
+
+// Frees a name table's memory
+void nameFree(struct nameTable* names){
+	free(names->slots);
+	free(names->stamps);
+	memset(names, 0, sizeof(*names));
+}
+
+// Hashes the name of a directory entry. Names are padded with zeros, so all
+// DIRSIZ bytes are hashed.
+uint64_t nameHash(const uchar* entry){
+	uint64_t a, b;
+	memcpy(&a, entry + sizeof(ushort), sizeof(a));
+	memcpy(&b, entry + sizeof(struct dirent) - sizeof(b), sizeof(b));
+
+	uint64_t hash = a * PRIME64_1 ^ ((b * PRIME64_2) << 31 | (b * PRIME64_2) >> 33);
+	hash ^= hash >> 33;
+	hash *= PRIME64_3;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+// Adds an entry's name to a name table with room for it, returning NAME_ADDED,
+// NAME_REPEATED if the table holds it already, or NAME_BAD if it is empty or has
+// bytes after its end. Compares the names byte by byte.
+int nameInsertScalar(struct nameTable* names, const struct dirent* entry){
+	uint length;
+	for(length = 0; length < DIRSIZ && entry->name[length] != '\0'; length++);
+	if(length == 0)
+		return NAME_BAD;
+
+	uint i;
+	for(i = length; i < DIRSIZ; i++){
+		if(entry->name[i] != '\0')
+			return NAME_BAD;
+	}
+
+	uint mask = names->cap - 1;
+	uint at = nameHash((const uchar*)entry) & mask;
+	while(names->stamps[at] == names->generation){
+		struct dirent* slot = (struct dirent*)&names->slots[(size_t)at * sizeof(struct dirent)];
+		if(memcmp(slot->name, entry->name, DIRSIZ) == 0)
+			return NAME_REPEATED;
+		at = (at + 1) & mask;
+	}
+
+	memcpy(&names->slots[(size_t)at * sizeof(struct dirent)], entry, sizeof(struct dirent));
+	names->stamps[at] = names->generation;
+	names->count++;
+	return NAME_ADDED;
+}
+
+#ifdef HAVE_X86_SIMD
+// SSE2 version of nameInsertScalar. An entry is 16 bytes, so its name is checked, and
+// compared against a slot, with one load and one compare, the inode number masked off.
+__attribute__((target("sse2")))
+int nameInsertSSE2(struct nameTable* names, const struct dirent* entry){
+	const uint nameBytes = 0xffff & ~((1 << sizeof(ushort)) - 1);
+	__m128i name = _mm_loadu_si128((const __m128i*)entry);
+	uint zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(name, _mm_setzero_si128())) & nameBytes;
+
+	// Every byte from the first zero on must be zero, and the first can't be
+	if(zeros != 0){
+		uint after = nameBytes & ~((1u << __builtin_ctz(zeros)) - 1);
+		if((zeros & (1 << sizeof(ushort))) || (zeros & after) != after)
+			return NAME_BAD;
+	}
+
+	uint mask = names->cap - 1;
+	uint at = nameHash((const uchar*)entry) & mask;
+	while(names->stamps[at] == names->generation){
+		__m128i slot = _mm_load_si128((const __m128i*)&names->slots[(size_t)at * sizeof(struct dirent)]);
+		if((_mm_movemask_epi8(_mm_cmpeq_epi8(slot, name)) & nameBytes) == nameBytes)
+			return NAME_REPEATED;
+		at = (at + 1) & mask;
+	}
+
+	_mm_store_si128((__m128i*)&names->slots[(size_t)at * sizeof(struct dirent)], name);
+	names->stamps[at] = names->generation;
+	names->count++;
+	return NAME_ADDED;
+}
+#endif
+
+// ***
+// *
+// *   Finding functions
+// *
+// ***
+
+// Records a broken rule. Findings past maxFindings are counted, but not kept.
+void addFinding(struct xcheck* xc, uint rule, uint inum, uint block, uint firstInum){
+	pthread_mutex_lock(&xc->lock);
+
+	// Grow the list as needed, up to the cap
+	if(xc->nfindings == xc->findingsCap && xc->findingsCap < xc->maxFindings){
+		unsigned long cap = xc->findingsCap == 0 ? 64 : xc->findingsCap * 2;
+		if(cap > xc->maxFindings)
+			cap = xc->maxFindings;
+
+		struct xcheckFinding* grown = realloc(xc->findings, cap * sizeof(struct xcheckFinding));
+		if(grown != NULL){
+			xc->findings = grown;
+			xc->findingsCap = cap;
+		} else if(xc->error == XCHECK_OK){
+			// The lock is already held, so the error is recorded here
+			xc->error = XCHECK_ENOMEM;
+			snprintf(xc->message, sizeof(xc->message), "could not allocate findings");
+		}
+	}
+
+	if(xc->nfindings < xc->findingsCap){
+		xc->findings[xc->nfindings].rule = rule;
+		xc->findings[xc->nfindings].inum = inum;
+		xc->findings[xc->nfindings].block = block;
+		xc->findings[xc->nfindings].firstInum = firstInum;
+	}
+
+	xc->nfindings++;
+	pthread_mutex_unlock(&xc->lock);
+}
+
+// Orders findings by rule, then inode, then block
+int compareFindings(const void* a, const void* b){
+	const struct xcheckFinding* x = a;
+	const struct xcheckFinding* y = b;
+
+	if(x->rule != y->rule)
+		return x->rule < y->rule ? -1 : 1;
+	if(x->inum != y->inum)
+		return x->inum < y->inum ? -1 : 1;
+	if(x->block != y->block)
+		return x->block < y->block ? -1 : 1;
+
+	return 0;
+}
+
+// Records each out of range address of an inode as a finding, and marks the addresses
+// in range in the worker's block map, so the bitmap and duplicate rules still cover
+// them. Indirect blocks only listed addresses if their own address is in range. The
+// findings are recorded in the first window only.
+void markAddresses(struct xcheck* xc, struct sweeper* self, uint inum){
+	uint length;
+	uint* row = inodeAddrs(xc, inum, &length);
+
+	uint i;
+	for(i = 0; i < length; i++){
+		if(row[i] == 0)
+			continue;
+
+		if(addressInRange(xc, row[i]))
+			markBlock(xc, self, row[i]);
+		else if(xc->windowBase == 0)
+			addFinding(xc, i < NADDRS ? XCHECK_RULE_BAD_DIRECT : XCHECK_RULE_BAD_INDIRECT, inum, row[i], 0);
+	}
+
+	// A row cut short is reported at the indirect block it stops in
+	if(xc->windowBase == 0 && rowClipped(xc, inum)){
+		uint ndirect = xc->layout->ndirect;
+		uint nindirect = xc->blockSize / sizeof(uint);
+		addFinding(xc, XCHECK_RULE_BAD_INDIRECT, inum, row[xc->index.listed[inum] < nindirect ? ndirect : ndirect + 1], 0);
+	}
+}
+
+// ***
+// *
+// *   State functions
+// *
+// ***
+
+// Digests every region of the image, splitting the regions between the given number
+// of threads
+void digestRegions(struct xcheck* xc, int threads){
+	uint inodeBlocks = xc->bmapStart - xc->inodeStart;
+	xc->ndigests = 1 + inodeBlocks + xc->bmapBlocks;
+	xc->changedRegions = xc->ndigests;
+	xc->digests = malloc(xc->ndigests * sizeof(uint64_t));
+	if(xc->digests == NULL){
+		setError(xc, XCHECK_ENOMEM, "could not allocate region digests");
+		return;
+	}
+
+	if((uint)threads > xc->ndigests)
+		threads = xc->ndigests;
+
+	// A single worker runs on the main thread. The regions of a worker which can't be
+	// started are taken by the others.
+	pthread_t* workers = calloc(threads, sizeof(pthread_t));
+	int started = 0;
+	if(threads > 1 && workers != NULL){
+		for(started = 0; started < threads; started++){
+			if(pthread_create(&workers[started], NULL, digestWorker, xc) != 0)
+				break;
+		}
+	}
+
+	if(started == 0)
+		digestWorker(xc);
+
+	int i;
+	for(i = 0; i < started; i++){
+		pthread_join(workers[i], NULL);
+	}
+
+	free(workers);
+}
+
+// Digests regions until there are none left to take
+void* digestWorker(void* arg){
+	struct xcheck* xc = arg;
+
+	uint region;
+	while((region = atomic_fetch_add(&xc->digestNext, 1)) < xc->ndigests){
+		xc->digests[region] = digestRegion(xc, region);
+	}
+
+	return NULL;
+}
+
+// Digests one region. Region 0 is the super block, with the log header and committed
+// blocks, and the bitmap blocks come after the inode table. The digest of an inode
+// table block takes in every block its inodes could have the checker read: indirect
+// blocks, and the blocks of directories. The inode table and bitmap are digested as
+// the log leaves them.
+uint64_t digestRegion(struct xcheck* xc, uint region){
+	uint inodeBlocks = xc->bmapStart - xc->inodeStart;
+
+	if(region == 0){
+		uint64_t digest = xxh64(xc->superBlock, xc->blockSize, 0);
+		if(xc->logHeader != NULL)
+			digest = xxh64(xc->logHeader, xc->blockSize, digest);
+		if(xc->logCommitted != 0)
+			digest = xxh64(xc->logData, (size_t)xc->logCommitted * xc->blockSize, digest);
+
+		return digest;
+	}
+
+	if(region > inodeBlocks)
+		return xxh64(xc->bmap + (size_t)(region - 1 - inodeBlocks) * xc->blockSize, xc->blockSize, 0);
+
+	uint perBlock = xc->blockSize / sizeof(struct dinode);
+	uint first = (region - 1) * perBlock;
+	uint64_t digest = xxh64((char*)xc->inodes + (size_t)(region - 1) * xc->blockSize, xc->blockSize, 0);
+
+	// Quick checks read no blocks through the inodes
+	if(xc->level == XCHECK_LEVEL_QUICK)
+		return digest;
+
+	uint ndirect = xc->layout->ndirect;
+	uint i;
+	for(i = first; i < first + perBlock && i < xc->superBlock->ninodes; i++){
+		struct dinode* inode = &xc->inodes[i];
+		if(inode->type == T_UNALLOC)
+			continue;
+
+		if(xc->stats)
+			atomic_fetch_add_explicit(&xc->inodesVisited, 1, memory_order_relaxed);
+
+		// Each block read is chained onto the digest
+		struct block b;
+		uint j;
+		if(inode->type == T_DIR){
+			for(j = 0; j < ndirect; j++){
+				digestBlock(xc, inode->addrs[j], &b, &digest);
+			}
+		}
+
+		digest = digestIndirect(xc, inode->addrs[ndirect], 1, inode->type == T_DIR, digest);
+		if(xc->layout->depth == 2)
+			digest = digestIndirect(xc, inode->addrs[ndirect + 1], 2, inode->type == T_DIR, digest);
+	}
+
+	return digest;
+}
+
+// Chains a block onto a digest, reading it into b, if the checker could read it: its
+// address is in range, and within the image. Returns 1 if the block was read.
+int digestBlock(struct xcheck* xc, uint address, struct block* b, uint64_t* digest){
+	if(address == 0 || !addressInRange(xc, address) || ((size_t)address + 1) * xc->blockSize > xc->size)
+		return 0;
+
+	bread(xc, address, b);
+	*digest = xxh64(b->data, xc->blockSize, *digest);
+	return 1;
+}
+
+// Chains an indirect block of the given depth onto a digest, along with the indirect
+// blocks it lists, and the data blocks they list if they are a directory's
+uint64_t digestIndirect(struct xcheck* xc, uint address, int depth, int directory, uint64_t digest){
+	struct block b;
+	if(!digestBlock(xc, address, &b, &digest) || (depth == 1 && !directory))
+		return digest;
+
+	// The addresses are copied out, as reading the next block may reuse b
+	uint addresses[MAX_BLOCK_SIZE / sizeof(uint)];
+	uint count = xc->blockSize / sizeof(uint);
+	memcpy(addresses, b.data, count * sizeof(uint));
+
+	uint j;
+	for(j = 0; j < count; j++){
+		if(depth > 1)
+			digest = digestIndirect(xc, addresses[j], depth - 1, directory, digest);
+		else
+			digestBlock(xc, addresses[j], &b, &digest);
+	}
+
+	return digest;
+}
+
+// Reads the state file, counting the regions which changed since it was written. If
+// none did, and the state was written checking the same way, the findings it holds
+// become this check's and the verdict is returned. Otherwise returns -1 and the image
+// is checked in full.
+int loadState(struct xcheck* xc){
+	if(xc->full)
+		return -1;
+
+	FILE* file = fopen(xc->statePath, "rb");
+	if(file == NULL)
+		return -1;
+
+	// The state must describe this image, checked the same way
+	struct stateHeader header;
+	if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, STATE_MAGIC, sizeof(STATE_MAGIC)) != 0 ||
+		header.version != STATE_VERSION || header.nregions != xc->ndigests || header.imageBytes != xc->size ||
+		header.blockSize != xc->blockSize || header.depth != xc->layout->depth ||
+		header.size != xc->superBlock->size || header.nblocks != xc->superBlock->nblocks ||
+		header.ninodes != xc->superBlock->ninodes || header.all != xc->all || header.maxFindings != xc->maxFindings ||
+		header.level != xc->level ||
+		header.kept > header.nfindings || header.kept > xc->maxFindings){
+		fclose(file);
+		return -1;
+	}
+
+	uint64_t* digests = malloc(xc->ndigests * sizeof(uint64_t));
+	if(digests == NULL || fread(digests, sizeof(uint64_t), xc->ndigests, file) != xc->ndigests){
+		free(digests);
+		fclose(file);
+		return -1;
+	}
+
+	xc->changedRegions = 0;
+	uint i;
+	for(i = 0; i < xc->ndigests; i++){
+		if(digests[i] != xc->digests[i])
+			xc->changedRegions++;
+	}
+	free(digests);
+
+	if(xc->changedRegions > 0){
+		fclose(file);
+		return -1;
+	}
+
+	// Nothing changed, so the findings stand
+	struct xcheckFinding* findings = malloc((header.kept > 0 ? header.kept : 1) * sizeof(struct xcheckFinding));
+	if(findings == NULL || fread(findings, sizeof(struct xcheckFinding), header.kept, file) != header.kept){
+		free(findings);
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+
+	xc->findings = findings;
+	xc->findingsCap = header.kept;
+	xc->nfindings = header.nfindings;
+	return header.result;
+}
+
+// Writes the digests, the verdict and the findings kept to the state file. The file
+// is replaced whole, so an interrupted write leaves the old state.
+void saveState(struct xcheck* xc, int result){
+	if(xc->digests == NULL || xc->error != XCHECK_OK)
+		return;
+
+	struct stateHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, STATE_MAGIC, sizeof(STATE_MAGIC));
+	header.version = STATE_VERSION;
+	header.nregions = xc->ndigests;
+	header.imageBytes = xc->size;
+	header.blockSize = xc->blockSize;
+	header.depth = xc->layout->depth;
+	header.size = xc->superBlock->size;
+	header.nblocks = xc->superBlock->nblocks;
+	header.ninodes = xc->superBlock->ninodes;
+	header.all = xc->all;
+	header.maxFindings = xc->maxFindings;
+	header.level = xc->level;
+	header.result = result;
+	header.nfindings = xc->nfindings;
+	header.kept = xc->nfindings < xc->findingsCap ? xc->nfindings : xc->findingsCap;
+
+	char* temp = malloc(strlen(xc->statePath) + 5);
+	if(temp == NULL){
+		setError(xc, XCHECK_ENOMEM, "could not write state file");
+		return;
+	}
+	sprintf(temp, "%s.tmp", xc->statePath);
+
+	FILE* file = fopen(temp, "wb");
+	int written = file != NULL &&
+		fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(xc->digests, sizeof(uint64_t), xc->ndigests, file) == xc->ndigests &&
+		(header.kept == 0 || fwrite(xc->findings, sizeof(struct xcheckFinding), header.kept, file) == header.kept);
+	if(file != NULL && fclose(file) != 0)
+		written = 0;
+
+	if(!written || rename(temp, xc->statePath) != 0){
+		unlink(temp);
+		setError(xc, XCHECK_EOPEN, "could not write state file");
+	}
+
+	free(temp);
+}
+
+// Returns the xxHash64 digest of length bytes, continuing from seed
+uint64_t xxh64(const void* input, size_t length, uint64_t seed){
+	const uchar* p = input;
+	const uchar* end = p + length;
+	uint64_t h;
+
+	if(length >= 32){
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME64_1;
+
+		// Four lanes of 8 bytes at a time
+		do{
+			v1 = xxhRound(v1, xxhRead64(p));
+			v2 = xxhRound(v2, xxhRead64(p + 8));
+			v3 = xxhRound(v3, xxhRead64(p + 16));
+			v4 = xxhRound(v4, xxhRead64(p + 24));
+			p += 32;
+		} while(p + 32 <= end);
+
+		h = ((v1 << 1) | (v1 >> 63)) + ((v2 << 7) | (v2 >> 57)) +
+			((v3 << 12) | (v3 >> 52)) + ((v4 << 18) | (v4 >> 46));
+		h = xxhMerge(h, v1);
+		h = xxhMerge(h, v2);
+		h = xxhMerge(h, v3);
+		h = xxhMerge(h, v4);
+	} else{
+		h = seed + PRIME64_5;
+	}
+
+	h += length;
+
+	// The tail
+	while(p + 8 <= end){
+		h ^= xxhRound(0, xxhRead64(p));
+		h = ((h << 27) | (h >> 37)) * PRIME64_1 + PRIME64_4;
+		p += 8;
+	}
+
+	if(p + 4 <= end){
+		h ^= (uint64_t)xxhRead32(p) * PRIME64_1;
+		h = ((h << 23) | (h >> 41)) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	while(p < end){
+		h ^= *p * PRIME64_5;
+		h = ((h << 11) | (h >> 53)) * PRIME64_1;
+		p++;
+	}
+
+	// Mix the final bits
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+// Takes 8 bytes of input into an xxHash64 lane
+uint64_t xxhRound(uint64_t acc, uint64_t input){
+	acc += input * PRIME64_2;
+	acc = (acc << 31) | (acc >> 33);
+	return acc * PRIME64_1;
+}
+
+// Merges an xxHash64 lane into the digest
+uint64_t xxhMerge(uint64_t acc, uint64_t lane){
+	acc ^= xxhRound(0, lane);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+// Read unaligned words
+uint64_t xxhRead64(const uchar* p){
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+uint32_t xxhRead32(const uchar* p){
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// ***
+// *
+// *   Stats functions
+// *
+// ***
+
+// Runs a check, timing it as a stage when stats are kept
+int runCheck(struct xcheck* xc, const char* name, int (*check)(struct xcheck*)){
+	statsBegin(xc, name);
+	int passed = check(xc);
+	statsEnd(xc);
+
+	return passed;
+}
+
+// Starts timing a stage. Stages don't nest.
+void statsBegin(struct xcheck* xc, const char* name){
+	if(!xc->stats)
+		return;
+
+	xc->stageName = name;
+	xc->stageInodes = xc->inodesVisited;
+	xc->stageBlocks = xc->blocksRead;
+	getrusage(RUSAGE_SELF, &xc->stageUsage);
+	clock_gettime(CLOCK_MONOTONIC, &xc->stageWall);
+}
+
+// Finishes timing the current stage, recording the time, counters and faults since
+// statsBegin. CPU time and faults cover all threads. A stage run more than once, as
+// the sweep is for each window, adds to its earlier runs.
+void statsEnd(struct xcheck* xc){
+	if(!xc->stats)
+		return;
+
+	int i;
+	for(i = 0; i < xc->nstages && strcmp(xc->stages[i].name, xc->stageName) != 0; i++);
+	if(i == MAX_STAGES)
+		return;
+
+	struct xcheckStage* stage = &xc->stages[i];
+	if(i == xc->nstages){
+		memset(stage, 0, sizeof(*stage));
+		stage->name = xc->stageName;
+		xc->nstages++;
+	}
+
+	stage->wallMs += msSince(&xc->stageWall);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	stage->cpuMs += cpuMs(&usage) - cpuMs(&xc->stageUsage);
+	stage->minorFaults += usage.ru_minflt - xc->stageUsage.ru_minflt;
+	stage->majorFaults += usage.ru_majflt - xc->stageUsage.ru_majflt;
+	stage->inodes += xc->inodesVisited - xc->stageInodes;
+	stage->blocks += xc->blocksRead - xc->stageBlocks;
+}
+
+// Returns the milliseconds elapsed since start
+double msSince(struct timespec* start){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Returns the user and system CPU time in usage, in milliseconds
+double cpuMs(struct rusage* usage){
+	return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * 1000.0 +
+		(usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) / 1000.0;
+}
+
+// ***
+// *
+// *   Bitmap functions
+// *
+// ***
+
+// Picks the widest AND_NOT_KERNEL and NAME_KERNEL the CPU supports
+void initBitmapKernel(){
+	AND_NOT_KERNEL = andNotScalar;
+	NAME_KERNEL = nameInsertScalar;
+
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		AND_NOT_KERNEL = andNotAVX2;
+	else if(__builtin_cpu_supports("sse2"))
+		AND_NOT_KERNEL = andNotSSE2;
+	if(__builtin_cpu_supports("sse2"))
+		NAME_KERNEL = nameInsertSSE2;
+#endif
+}
+
+// Returns the first bit index in [from, to) that is set in a but clear in b, or to if
+// there is none. Whole bytes are compared by AND_NOT_KERNEL, and the ragged ends
+// bit by bit.
+long firstAndNot(const uchar* a, const uchar* b, long from, long to){
+	// Examine the bits up to the first byte boundary
+	for(; from < to && from % 8 != 0; from++){
+		if((a[from / 8] & ~b[from / 8]) & (1 << (from % 8)))
+			return from;
+	}
+
+	// Compare the whole bytes in bulk, then pinpoint the differing bit
+	long lastByte = to / 8;
+	if(from / 8 < lastByte){
+		long byte = AND_NOT_KERNEL(a, b, from / 8, lastByte);
+		if(byte < lastByte)
+			return byte * 8 + __builtin_ctz(a[byte] & ~b[byte] & 0xff);
+
+		from = lastByte * 8;
+	}
+
+	// Examine the bits after the last byte boundary
+	for(; from < to; from++){
+		if((a[from / 8] & ~b[from / 8]) & (1 << (from % 8)))
+			return from;
+	}
+
+	return to;
+}
+
+// Returns the number of bits set in map in [from, to)
+long countSet(const uchar* map, long from, long to){
+	long count = 0;
+
+	// Count up to a word boundary, a word at a time, then the rest
+	for(; from < to && (from % 64) != 0; from++){
+		count += (map[from / 8] >> (from % 8)) & 1;
+	}
+
+	for(; from + 64 <= to; from += 64){
+		uint64_t word;
+		memcpy(&word, map + from / 8, sizeof(word));
+		count += __builtin_popcountll(word);
+	}
+
+	for(; from < to; from++){
+		count += (map[from / 8] >> (from % 8)) & 1;
+	}
+
+	return count;
+}
+
+// Returns the first bit index in [from, to) that is set in map, or to if there is none
+long firstSet(const uchar* map, long from, long to){
+	for(; from < to; from++){
+		// Skip over empty bytes at a time
+		if(from % 8 == 0 && to - from >= 8 && map[from / 8] == 0){
+			from += 7;
+			continue;
+		}
+
+		if(map[from / 8] & (1 << (from % 8)))
+			return from;
+	}
+
+	return to;
+}
+
+// Returns the first byte in [from, to) where a & ~b is nonzero, or to if there is none.
+// Compares 64 bits at a time.
+long andNotScalar(const uchar* a, const uchar* b, long from, long to){
+	for(; from + 8 <= to; from += 8){
+		unsigned long long wa, wb;
+		memcpy(&wa, a + from, 8);
+		memcpy(&wb, b + from, 8);
+		if(wa & ~wb)
+			break;
+	}
+
+	for(; from < to; from++){
+		if(a[from] & ~b[from])
+			return from;
+	}
+
+	return to;
+}
+
+#ifdef HAVE_X86_SIMD
+// SSE2 version of andNotScalar, comparing 128 bits at a time
+__attribute__((target("sse2")))
+long andNotSSE2(const uchar* a, const uchar* b, long from, long to){
+	__m128i zero = _mm_setzero_si128();
+	for(; from + 16 <= to; from += 16){
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + from));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + from));
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_andnot_si128(vb, va), zero));
+		if(mask != 0xffff)
+			return from + __builtin_ctz(~mask);
+	}
+
+	return andNotScalar(a, b, from, to);
+}
+
+// AVX2 version of andNotScalar, comparing 256 bits at a time
+__attribute__((target("avx2")))
+long andNotAVX2(const uchar* a, const uchar* b, long from, long to){
+	__m256i zero = _mm256_setzero_si256();
+	for(; from + 32 <= to; from += 32){
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + from));
+		__m256i vb = _mm256_loadu_si256((const __m256i*)(b + from));
+		unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_andnot_si256(vb, va), zero));
+		if(mask != 0xffffffffu)
+			return from + __builtin_ctz(~mask);
+	}
+
+	return andNotScalar(a, b, from, to);
+}
+#endif
+
+// ***
+// *
+// *   Utility functions
+// *
+// ***
+
+// Checks if the directory inode passed to it is properly defined
+int validDirect(struct xcheck* xc, uint inum){
+	// Get the block addresses 
+	// We only need to examine the first block address
+	uint length;
+	uint* refBlocks = inodeAddrs(xc, inum, &length);
+
+	// If the first address, is zero, it is unallocated, and
+	// thus technically valid
+	if(refBlocks[0] == 0)
+		return 1;
+
+	// Read the first address block
+	struct block b;
+	bread(xc, refBlocks[0], &b);
+
+	// Get the directory data
+	struct dirent* entry = (struct dirent*)b.data;
+	
+	// Check the first entry refers to '.'. Names fill DIRSIZ bytes without a terminator.
+	if(strncmp(entry[0].name, ".", DIRSIZ) != 0)
+		return 0;
+	
+	// Check the second entry refers to '..'
+	if(strncmp(entry[1].name, "..", DIRSIZ) != 0)
+		return 0;
+	
+	// Check that the first entry's inode refers to this inoude object
+	if(entry[0].inum != inum)
+		return 0;
+
+	// All tests passed. Return true.
+	return 1;
+
+}
+
+// Checks if the addresses of the passed inode are valid, returning one of the
+// ADDR_* codes
+int validAddresses(struct xcheck* xc, uint inum){
+	// Get the blocks pointed to by the inode
+	uint length;
+	uint* refBlocks = inodeAddrs(xc, inum, &length);
+
+	// Iterate over the addresses held by the inode
+	uint i;
+	for(i = 0; i < NADDRS; i++){
+		// If the block is unallocated, don't worry about it
+		if(refBlocks[i] == 0)
+			continue;
+		
+		// If the block address is out of range, throw an error
+		if(!addressInRange(xc, refBlocks[i]))
+			return ADDR_BAD_DIRECT;
+	}
+
+	// Iterate through the addresses from the indirect blocks
+	for(i = NADDRS; i < length; i++){
+		// If block addresses are out of range, throw an error
+		if(!addressInRange(xc, refBlocks[i]))
+			return ADDR_BAD_INDIRECT;
+	}
+
+	// A row cut short by the image's budget lists more than the image holds
+	if(rowClipped(xc, inum))
+		return ADDR_BAD_INDIRECT;
+
+	// Otheriwse, the test has succeeded
+	return ADDR_OK;
+}
+
+// Returns 1 if the row of an inode lists fewer blocks than its size calls for, having
+// run out of the image's budget for listed blocks
+int rowClipped(struct xcheck* xc, uint inum){
+	if(!xc->index.resolve)
+		return 0;
+
+	return xc->index.listed[inum] < xc->layout->listed(xc, xc->index.size[inum], xc->inodes[inum].addrs);
+}
+
+// Checks if a block address lies in the data region, as far as the address test
+// is concerned. Unallocated addresses are in range.
+int addressInRange(struct xcheck* xc, uint blockIndex){
+	if(blockIndex == 0)
+		return 1;
+
+	return blockIndex >= (uint)xc->dataOffset && blockIndex <= xc->dataEnd;
+}
+
+// Allocates an empty block map with one bit per block in the file system
+uchar* allocBlockMap(struct xcheck* xc){
+	uchar* map = calloc(blockMapBytes(xc), 1);
+	if(map == NULL)
+		setError(xc, XCHECK_ENOMEM, "could not allocate block map");
+
+	return map;
+}
+
+// Returns the number of bytes in a block map, which covers a window of blocks once
+// the windows are planned
+uint blockMapBytes(struct xcheck* xc){
+	uint bits = xc->windowBlocks != 0 ? xc->windowBlocks : mapBlocks(xc);
+
+	return bits / 8 + 1;
+}
+
+// Returns the number of blocks the block maps cover between them: every block of the
+// file system, which takes in every block the bitmap could mark in use, so the two
+// can be compared directly
+uint mapBlocks(struct xcheck* xc){
+	return xc->superBlock->size;
+}
+
+// Marks the block at blockIndex as referenced by an inode in the worker's block map,
+// if it is in the current window
+void markBlock(struct xcheck* xc, struct sweeper* self, uint blockIndex){
+	// Unallocated addresses aren't references
+	if(blockIndex == 0)
+		return;
+
+	// Blocks past the end of the file system are out of range, and reported by the
+	// address rules instead
+	if(blockIndex >= xc->superBlock->size)
+		return;
+
+	// Blocks in other windows are marked in their own sweep
+	if(blockIndex < xc->windowBase || blockIndex - xc->windowBase >= xc->windowBlocks)
+		return;
+	blockIndex -= xc->windowBase;
+
+	// A block already in the map has been referenced before
+	uchar bit = 1 << (blockIndex % 8);
+	self->dupMap[blockIndex / 8] |= self->blockMap[blockIndex / 8] & bit;
+	self->blockMap[blockIndex / 8] |= bit;
+}
+
+// Returns the number of entries a directory of the given size holds, no more than fit
+// in the largest file of the layout
+uint directoryEntries(struct xcheck* xc, uint size){
+	unsigned long nindirect = xc->blockSize / sizeof(uint);
+	unsigned long blocks = xc->layout->ndirect + nindirect + (xc->layout->depth == 2 ? nindirect * nindirect : 0);
+	if(size > blocks * xc->blockSize)
+		size = blocks * xc->blockSize;
+
+	return size / sizeof(struct dirent);
+}
+
+// Examines if the block at block index is marked as "in use" by the bitmap
+int blockInUse(struct xcheck* xc, int blockIndex){
+	// If we're trying to access an invalid block, return false
+	if(blockIndex < 0)
+		return 0;
+
+	if(blockIndex > (long)xc->dataEnd - 1)
+		return 0;
+	
+	// If the bit is '0' at the index, then the block is not in use
+	if(!blockBit(xc, blockIndex))
+		return 0;
+
+	// Otherwise, assume the block is in use, and return true
+	return 1;
+}
+
+// Checks if the type supplied is usable in the application
+// xv6 file systems only support 3 explicit serial types, so we only
+// need to check within a range
+int useableType(int type){
+	if(type > 0 && type < 4)
+		return 1;
+
+	return 0;
+}
+
+// Checks if an inode of the type given to it is valid
+int validInode(int type){
+	// If the type of the inode isn't recognized as immediately useable,
+	// examine it more
+	if(!useableType(type)){
+		// If the inode is just unallocated, return true
+		if(type == T_UNALLOC)
+			return 1;
+
+		// Otherwise, return false
+		return 0;
+	}
+	
+	// If the type is immediately useable, return true;
+	return 1;
+}
+
+// Gets the bit from the bitmap at the given index
+int blockBit(struct xcheck* xc, int index){
+	// If we the desired block index is unaccesible, return 0
+	if(index < 1 || index >= bitmapEnd(xc))
+		return 0;
+
+	// Bit we will return
+	int bit;
+
+	// Get the byte the bit is in
+	int byte = index / 8;
+
+	// Get the position within the byte the index references
+	int bitPos = index % 8;
+	
+	// Shift and mask the bits to get the one we want
+	uchar raw = xc->bmap[byte];
+	raw = raw >> bitPos;
+	raw = raw & 0x1;
+
+	// Convert and return our bit in a more useable state
+	bit = (int)raw;
+	return bit;
+}
+
+// Returns the end of the range of block indexes which may be marked in use by the
+// bitmap: up to and including the end of the data region, as far as the bitmap reaches
+long bitmapEnd(struct xcheck* xc){
+	long end = (long)xc->dataEnd + 1;
+	if(end > (long)xc->bmapBlocks * xc->blockSize * 8)
+		end = (long)xc->bmapBlocks * xc->blockSize * 8;
+
+	return end;
+}
+
+// Reads the block data at position index into a block structure, as it is once the
+// log is replayed. Addresses the super block allows can lie past the end of a short
+// image; those blocks read as zeros.
+void bread(struct xcheck* xc, uint index, struct block* b){
+	if(((size_t)index + 1) * xc->blockSize > xc->size){
+		b->data = (char*)ZERO_BLOCK;
+		return;
+	}
+
+	// Blocks the log replaces read as their copies in the log
+	if(xc->noverlay != 0 && (b->data = overlayBlock(xc, index)) != NULL)
+		return;
+
+	if(xc->stats)
+		atomic_fetch_add_explicit(&xc->blocksRead, 1, memory_order_relaxed);
+
+	xc->source->read(xc, index, b);
+}
+
+// Opens the image and prepares the block source to read it.
+// Returns XCHECK_OK, or the error which stopped it.
+int init(struct xcheck* xc, const char* fileName){
+	// Get the file descriptor to the file system
+	xc->fd = open(fileName, O_RDONLY | xc->source->openFlags);
+
+	// If there was an error, record why
+	if(xc->fd < 0){
+		char message[sizeof(xc->message)];
+		if(errno == EINVAL)
+			snprintf(message, sizeof(message), "image can't be opened for %s reads", xc->source->name);
+		else
+			snprintf(message, sizeof(message), "image not found");
+		setError(xc, XCHECK_EOPEN, message);
+		return xc->error;
+	}
+
+	// Get info on the file system
+	struct stat finfo;
+	if(fstat(xc->fd, &finfo) < 0){
+		setError(xc, XCHECK_EOPEN, "could not load image statistics");
+		return xc->error;
+	}
+
+	// The image must at least hold the super block
+	xc->size = imageSize(xc, &finfo);
+	if(xc->error != XCHECK_OK)
+		return xc->error;
+
+	if(xc->size < 2 * MIN_BLOCK_SIZE){
+		setError(xc, XCHECK_EFORMAT, "image too small");
+		return xc->error;
+	}
+
+	// Prepare the block source
+	xc->source->open(xc);
+	if(xc->error != XCHECK_OK)
+		return xc->error;
+	xc->sourceOpen = 1;
+
+	return xc->error;
+}
+
+// Reads what the checks need of the open image: the super block, the inode table and
+// bitmap, and the log. Run again when the image changes, it forgets what it read
+// before. Returns XCHECK_OK, or the error which stopped it.
+int readImage(struct xcheck* xc){
+	xc->superBlock = NULL;
+	xc->layout = xc->givenLayout;
+	free(xc->overlay);
+	xc->overlay = NULL;
+	xc->noverlay = 0;
+	xc->logStart = 0;
+	xc->logBlocks = 0;
+	xc->logHeader = NULL;
+	xc->logData = NULL;
+	xc->logCommitted = 0;
+
+	// Read the start of the image, in the smallest blocks. It holds the super block and
+	// root inode of every layout.
+	xc->blockSize = MIN_BLOCK_SIZE;
+	size_t headBytes = xc->size < PROBE_BYTES ? xc->size : PROBE_BYTES;
+	char* head = xc->source->region(xc, 0, (headBytes + MIN_BLOCK_SIZE - 1) / MIN_BLOCK_SIZE);
+	if(head == NULL)
+		return xc->error;
+	if(xc->stats)
+		xc->blocksRead += 1;
+
+	// Find the block size unless the layout was given
+	xc->blockSize = xc->layout != NULL ? xc->layout->blockSize : probeBlockSize(xc, head, headBytes);
+	if(xc->size < 2 * (size_t)xc->blockSize){
+		setError(xc, XCHECK_EFORMAT, "image too small");
+		return xc->error;
+	}
+
+	// Read the super block
+	struct superblock* superBlock = (struct superblock*)&head[xc->blockSize];
+
+	// Read the inode table and bitmap, as the log leaves them
+	if(readRegions(xc, superBlock) != XCHECK_OK || replayLog(xc, superBlock) != XCHECK_OK)
+		return xc->error;
+
+	// The image is ready to check. Its inodes vote on the layout unless it was given.
+	xc->superBlock = superBlock;
+	if(xc->layout == NULL)
+		xc->layout = layoutFor(xc->blockSize, voteDepth(xc));
+
+	return xc->error;
+}
+
+// Finds where the regions of the image lie from its super block, and reads the inode
+// table and bitmap. Older images have the inode table at block 2, and the bitmap
+// right after it. Returns XCHECK_OK, or the error which stopped it.
+int readRegions(struct xcheck* xc, struct superblock* superBlock){
+	// The bitmap holds a bit for each block in the file system, and runs from the
+	// block holding the bit for block 0 to the one holding the bit for the last block
+	uint lastBlock = superBlock->size > 0 ? superBlock->size - 1 : 0;
+	uint inodeBlocks = superBlock->ninodes / (xc->blockSize / sizeof(struct dinode)) + 1;
+	xc->bmapBlocks = lastBlock / (xc->blockSize * 8) + 1;
+
+	if(newerLayout(superBlock)){
+		if(!regionsInOrder(superBlock, xc->blockSize)){
+			setError(xc, XCHECK_EFORMAT, "super block describes regions out of order");
+			return xc->error;
+		}
+
+		// The data blocks are the nblocks at the end of the file system, though the
+		// bitmap may have been given more blocks than it needs
+		xc->inodeStart = superBlock->inodestart;
+		xc->bmapStart = superBlock->bmapstart;
+		xc->dataOffset = xc->bmapStart + xc->bmapBlocks;
+		if(superBlock->nblocks < superBlock->size - xc->dataOffset)
+			xc->dataOffset = superBlock->size - superBlock->nblocks;
+		xc->dataEnd = superBlock->size - 1;
+		xc->logStart = superBlock->logstart;
+		xc->logBlocks = superBlock->nlog;
+	} else{
+		xc->inodeStart = 2;
+		xc->bmapStart = xc->inodeStart + inodeBlocks;
+		xc->dataOffset = xc->bmapStart + xc->bmapBlocks;
+		xc->dataEnd = superBlock->nblocks;
+
+		// A super block may give more data blocks than the file system holds
+		if(xc->dataEnd > lastBlock)
+			xc->dataEnd = lastBlock;
+	}
+
+	// The inode table and bitmap must lie within the image
+	if((size_t)xc->dataOffset * xc->blockSize > xc->size){
+		setError(xc, XCHECK_EFORMAT, "image smaller than its super block describes");
+		return xc->error;
+	}
+
+	// Read the inode table, which is scanned from start to end
+	uint tableBlocks = xc->bmapStart - xc->inodeStart;
+	xc->source->advise(xc, xc->inodeStart, tableBlocks, ADVISE_SEQUENTIAL);
+	xc->inodes = (struct dinode*)xc->source->region(xc, xc->inodeStart, tableBlocks);
+	if(xc->inodes == NULL)
+		return xc->error;
+	if(xc->stats)
+		xc->blocksRead += tableBlocks;
+
+	// Read the used data block bitmap
+	xc->source->advise(xc, xc->bmapStart, xc->bmapBlocks, ADVISE_WILLNEED);
+	xc->bmap = xc->source->region(xc, xc->bmapStart, xc->bmapBlocks);
+	if(xc->bmap == NULL)
+		return xc->error;
+	if(xc->stats)
+		xc->blocksRead += xc->bmapBlocks;
+
+	return xc->error;
+}
+
+// Returns the size of the image in bytes. Block devices report a size of zero
+// through fstat, so their size is found by seeking to the end.
+size_t imageSize(struct xcheck* xc, struct stat* finfo){
+	if(S_ISBLK(finfo->st_mode)){
+		off_t size = lseek(xc->fd, 0, SEEK_END);
+		if(size < 0){
+			setError(xc, XCHECK_EOPEN, "could not load image statistics");
+			return 0;
+		}
+
+		return size;
+	}
+
+	return finfo->st_size;
+}
+
+// Returns the block which an inode at inodeIndex is located in
+int inode2Block(struct xcheck* xc, int inodeIndex){
+	return (inodeIndex / (xc->blockSize / sizeof(struct dinode))) + xc->inodeStart;
+}
+
+// ***
+// *
+// *   Log functions
+// *
+// ***
+
+// Returns 1 if a super block has the newer layout, which says where the log, inode
+// table and bitmap start. The older one leaves those fields zero.
+int newerLayout(struct superblock* superBlock){
+	return superBlock->inodestart != 0;
+}
+
+// Reads the log header, and lays the blocks the log has committed over those they are
+// copies of, as recovery would install them. Nothing is written to the image: the
+// inode table and bitmap are changed in memory, and bread() reads other blocks from
+// the log. Returns XCHECK_OK, or the error which stopped it.
+int replayLog(struct xcheck* xc, struct superblock* superBlock){
+	if(xc->logBlocks == 0)
+		return xc->error;
+
+	xc->logHeader = xc->source->region(xc, xc->logStart, 1);
+	if(xc->logHeader == NULL)
+		return xc->error;
+	if(xc->stats)
+		xc->blocksRead += 1;
+
+	// Nothing is committed unless the header lists blocks. It can't list more than
+	// the log or the header itself holds.
+	struct logheader* header = (struct logheader*)xc->logHeader;
+	if(header->n == 0)
+		return xc->error;
+
+	if(header->n < 0 || (uint)header->n > xc->logBlocks - 1 || (uint)header->n > xc->blockSize / sizeof(int) - 1){
+		setError(xc, XCHECK_EFORMAT, "log header lists more blocks than the log holds");
+		return xc->error;
+	}
+
+	xc->logCommitted = header->n;
+	xc->logData = xc->source->region(xc, xc->logStart + 1, xc->logCommitted);
+	xc->overlay = malloc(xc->logCommitted * sizeof(struct logBlock));
+	if(xc->logData == NULL || xc->overlay == NULL){
+		if(xc->overlay == NULL)
+			setError(xc, XCHECK_ENOMEM, "could not allocate log overlay");
+		return xc->error;
+	}
+	if(xc->stats)
+		xc->blocksRead += xc->logCommitted;
+
+	// Logged blocks are installed in order, so a block logged twice ends up as its
+	// last copy. Recovery only ever installs blocks past the log.
+	uint i;
+	for(i = 0; i < xc->logCommitted; i++){
+		uint block = header->block[i];
+		if(block < xc->inodeStart || block >= superBlock->size){
+			setError(xc, XCHECK_EFORMAT, "log lists a block outside the file system");
+			return xc->error;
+		}
+
+		xc->overlay[i].block = block;
+		xc->overlay[i].data = &xc->logData[(size_t)i * xc->blockSize];
+	}
+
+	qsort(xc->overlay, xc->logCommitted, sizeof(struct logBlock), compareLogBlocks);
+	for(i = 0; i < xc->logCommitted; i++){
+		if(xc->noverlay > 0 && xc->overlay[xc->noverlay - 1].block == xc->overlay[i].block)
+			xc->noverlay--;
+		xc->overlay[xc->noverlay++] = xc->overlay[i];
+	}
+
+	// The inode table and bitmap are read in place, not through bread()
+	overlayRegion(xc, (char*)xc->inodes, xc->inodeStart, xc->bmapStart - xc->inodeStart);
+	overlayRegion(xc, xc->bmap, xc->bmapStart, xc->bmapBlocks);
+
+	return xc->error;
+}
+
+// Copies the logged blocks which fall in a resident run of blocks over them
+void overlayRegion(struct xcheck* xc, char* region, uint start, uint count){
+	uint i;
+	for(i = 0; i < xc->noverlay; i++){
+		uint block = xc->overlay[i].block;
+		if(block < start || block - start >= count)
+			continue;
+
+		char* data = &region[(size_t)(block - start) * xc->blockSize];
+		xc->source->writable(xc, data, xc->blockSize);
+		memcpy(data, xc->overlay[i].data, xc->blockSize);
+	}
+}
+
+// Returns the logged copy of a block, or NULL if the log doesn't replace it
+char* overlayBlock(struct xcheck* xc, uint block){
+	uint low = 0, high = xc->noverlay;
+	while(low < high){
+		uint mid = low + (high - low) / 2;
+		if(xc->overlay[mid].block < block)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low < xc->noverlay && xc->overlay[low].block == block ? xc->overlay[low].data : NULL;
+}
+
+// Orders logged blocks by the block they replace, then by their place in the log
+int compareLogBlocks(const void* a, const void* b){
+	const struct logBlock* x = a;
+	const struct logBlock* y = b;
+
+	if(x->block != y->block)
+		return x->block < y->block ? -1 : 1;
+
+	return x->data < y->data ? -1 : x->data > y->data;
+}
+
+// ***
+// *
+// *   Block source functions
+// *
+// ***
+
+// Returns the block source with the given name, or NULL if there is none
+struct blockSource* findSource(const char* name){
+	int i;
+	for(i = 0; SOURCES[i].name != NULL; i++){
+		if(strcmp(SOURCES[i].name, name) == 0)
+			return &SOURCES[i];
+	}
+
+	return NULL;
+}
+
+// Maps the entire image into memory
+void mmapOpen(struct xcheck* xc){
+	xc->addr = mmap(NULL, xc->size, PROT_READ, MAP_PRIVATE, xc->fd, 0);
+	if(xc->addr == MAP_FAILED)
+		setError(xc, XCHECK_ENOMEM, "could not map image into memory");
+}
+
+// Points the block structure at the mapped block
+void mmapRead(struct xcheck* xc, uint index, struct block* b){
+	b->data = &xc->addr[(size_t)index * xc->blockSize];
+}
+
+// Returns the mapped run of blocks
+char* mmapRegion(struct xcheck* xc, uint start, uint count){
+	(void)count;
+	return &xc->addr[(size_t)start * xc->blockSize];
+}
+
+// Makes the pages holding a run of mapped blocks writable. The mapping is private, so
+// the pages written are copied, and the image is left as it is.
+void mmapWritable(struct xcheck* xc, char* data, size_t bytes){
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t begin = (data - xc->addr) / page * page;
+	size_t end = data - xc->addr + bytes;
+
+	if(mprotect(&xc->addr[begin], end - begin, PROT_READ | PROT_WRITE) != 0)
+		setError(xc, XCHECK_ENOMEM, "could not copy mapped blocks to replay the log");
+	xc->mapWritten = 1;
+}
+
+// Passes the advice on to the kernel for the pages holding the run of blocks
+void mmapAdvise(struct xcheck* xc, uint start, uint count, int advice){
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t begin = (size_t)start * xc->blockSize / page * page;
+	size_t end = (size_t)(start + count) * xc->blockSize;
+	if(end > xc->size)
+		end = xc->size;
+	if(begin >= end)
+		return;
+
+	madvise(&xc->addr[begin], end - begin, advice == ADVISE_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_WILLNEED);
+}
+
+// Pages not yet copied follow the file as it changes, but those copied to replay the
+// log hold the image as it was. Maps the image afresh if there are any.
+void mmapReload(struct xcheck* xc){
+	if(!xc->mapWritten)
+		return;
+
+	munmap(xc->addr, xc->size);
+	xc->mapWritten = 0;
+	mmapOpen(xc);
+}
+
+// Unmaps the image
+void mmapClose(struct xcheck* xc){
+	munmap(xc->addr, xc->size);
+}
+
+// Sets up the block cache. Memory use is fixed, whatever the size of the image.
+void preadOpen(struct xcheck* xc){
+	xc->cache = calloc(CACHE_LINES, sizeof(struct cacheLine));
+	if(xc->cache == NULL || posix_memalign((void**)&xc->cacheData, CACHE_LINE_SIZE, (size_t)CACHE_LINES * CACHE_LINE_SIZE) != 0){
+		free(xc->cache);
+		setError(xc, XCHECK_ENOMEM, "could not allocate block cache");
+		return;
+	}
+
+	int i;
+	for(i = 0; i < CACHE_LINES; i++){
+		pthread_mutex_init(&xc->cache[i].lock, NULL);
+		xc->cache[i].tag = -1;
+		xc->cache[i].data = &xc->cacheData[(size_t)i * CACHE_LINE_SIZE];
+	}
+
+	xc->nregions = 0;
+}
+
+// Copies a block into the block structure through the block cache. Each line is
+// locked while it's filled and copied from, so workers may read concurrently.
+void preadRead(struct xcheck* xc, uint index, struct block* b){
+	long tag = index / BLOCKS_PER_LINE(xc);
+	struct cacheLine* line = &xc->cache[tag % CACHE_LINES];
+
+	pthread_mutex_lock(&line->lock);
+	preadFill(xc, line, tag);
+	memcpy(b->buf, &line->data[(index % BLOCKS_PER_LINE(xc)) * xc->blockSize], xc->blockSize);
+	pthread_mutex_unlock(&line->lock);
+
+	b->data = b->buf;
+}
+
+// Fills a locked cache line with the given line of the image, unless it holds it already
+void preadFill(struct xcheck* xc, struct cacheLine* line, long tag){
+	if(line->tag == tag)
+		return;
+
+	preadSpan(xc, line->data, (off_t)tag * CACHE_LINE_SIZE, CACHE_LINE_SIZE);
+	line->tag = tag;
+}
+
+// Reads a run of blocks into memory which stays resident until the source is closed.
+// The read is widened to whole cache lines, so it is aligned for O_DIRECT.
+char* preadRegion(struct xcheck* xc, uint start, uint count){
+	if(xc->nregions == MAX_REGIONS){
+		setError(xc, XCHECK_ENOMEM, "too many resident regions");
+		return NULL;
+	}
+
+	off_t begin = (off_t)start * xc->blockSize / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+	off_t end = ((off_t)(start + count) * xc->blockSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+	char* region;
+	if(posix_memalign((void**)&region, CACHE_LINE_SIZE, end - begin) != 0){
+		setError(xc, XCHECK_ENOMEM, "could not allocate memory for image region");
+		return NULL;
+	}
+	xc->regions[xc->nregions++] = region;
+
+	preadSpan(xc, region, begin, end - begin);
+	return &region[(off_t)start * xc->blockSize - begin];
+}
+
+// Resident regions are copies of the image, so they can be changed as they are
+void preadWritable(struct xcheck* xc, char* data, size_t bytes){
+	(void)xc;
+	(void)data;
+	(void)bytes;
+}
+
+// Passes the advice on to the kernel, which starts reading the run into the page cache
+void preadAdvise(struct xcheck* xc, uint start, uint count, int advice){
+	posix_fadvise(xc->fd, (off_t)start * xc->blockSize, (off_t)count * xc->blockSize,
+		advice == ADVISE_SEQUENTIAL ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_WILLNEED);
+}
+
+// O_DIRECT reads bypass the page cache, so there is nothing to prefetch into
+void directAdvise(struct xcheck* xc, uint start, uint count, int advice){
+	(void)xc;
+	(void)start;
+	(void)count;
+	(void)advice;
+}
+
+// Empties the block cache and frees the resident regions, which hold the image as it
+// was read
+void preadReload(struct xcheck* xc){
+	int i;
+	for(i = 0; i < CACHE_LINES; i++){
+		xc->cache[i].tag = -1;
+	}
+
+	for(i = 0; i < xc->nregions; i++){
+		free(xc->regions[i]);
+	}
+	xc->nregions = 0;
+}
+
+// Frees the block cache and resident regions
+void preadClose(struct xcheck* xc){
+	int i;
+	for(i = 0; i < CACHE_LINES; i++){
+		pthread_mutex_destroy(&xc->cache[i].lock);
+	}
+	free(xc->cache);
+	free(xc->cacheData);
+
+	for(i = 0; i < xc->nregions; i++){
+		free(xc->regions[i]);
+	}
+	xc->nregions = 0;
+}
+
+// Reads len bytes at offset into buf. Anything past the end of the image reads as zeroes.
+void preadSpan(struct xcheck* xc, char* buf, off_t offset, size_t len){
+	size_t done = 0;
+	while(done < len){
+		ssize_t n = pread(xc->fd, buf + done, len - done, offset + done);
+		if(n < 0 && errno == EINTR)
+			continue;
+
+		// The rest reads as zeroes, and the check fails with the error
+		if(n < 0){
+			setError(xc, XCHECK_EREAD, "could not read image");
+			break;
+		}
+
+		// End of the image
+		if(n == 0)
+			break;
+
+		done += n;
+	}
+
+	memset(buf + done, 0, len - done);
+}
+
+#ifdef HAVE_IO_URING
+// Sets up the block cache and an io_uring to fill it asynchronously. Falls back to
+// plain pread if the kernel doesn't support io_uring.
+void uringOpen(struct xcheck* xc){
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	xc->ring.fd = syscall(__NR_io_uring_setup, xc->queueDepth, &params);
+	if(xc->ring.fd < 0){
+		xc->source = findSource("pread");
+		xc->source->open(xc);
+		return;
+	}
+
+	// Map the submission and completion rings, and the submission entries
+	xc->ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint);
+	xc->ring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP){
+		if(xc->ring.cqRingSize > xc->ring.sqRingSize)
+			xc->ring.sqRingSize = xc->ring.cqRingSize;
+		xc->ring.cqRingSize = xc->ring.sqRingSize;
+	}
+	xc->ring.sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	xc->ring.sqRing = mmap(NULL, xc->ring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xc->ring.fd, IORING_OFF_SQ_RING);
+	xc->ring.cqRing = xc->ring.sqRing;
+	if(!(params.features & IORING_FEAT_SINGLE_MMAP) && xc->ring.sqRing != MAP_FAILED)
+		xc->ring.cqRing = mmap(NULL, xc->ring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xc->ring.fd, IORING_OFF_CQ_RING);
+	xc->ring.sqes = mmap(NULL, xc->ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xc->ring.fd, IORING_OFF_SQES);
+	// Without the rings, unmap what was mapped and read through pread instead
+	if(xc->ring.sqRing == MAP_FAILED || xc->ring.cqRing == MAP_FAILED || xc->ring.sqes == MAP_FAILED){
+		if(xc->ring.sqes != MAP_FAILED)
+			munmap(xc->ring.sqes, xc->ring.sqesSize);
+		if(xc->ring.cqRing != MAP_FAILED && xc->ring.cqRing != xc->ring.sqRing)
+			munmap(xc->ring.cqRing, xc->ring.cqRingSize);
+		if(xc->ring.sqRing != MAP_FAILED)
+			munmap(xc->ring.sqRing, xc->ring.sqRingSize);
+		close(xc->ring.fd);
+
+		xc->source = findSource("pread");
+		xc->source->open(xc);
+		return;
+	}
+
+	char* sq = xc->ring.sqRing;
+	xc->ring.sqHead = (uint*)(sq + params.sq_off.head);
+	xc->ring.sqTail = (uint*)(sq + params.sq_off.tail);
+	xc->ring.sqMask = (uint*)(sq + params.sq_off.ring_mask);
+	xc->ring.sqArray = (uint*)(sq + params.sq_off.array);
+
+	char* cq = xc->ring.cqRing;
+	xc->ring.cqHead = (uint*)(cq + params.cq_off.head);
+	xc->ring.cqTail = (uint*)(cq + params.cq_off.tail);
+	xc->ring.cqMask = (uint*)(cq + params.cq_off.ring_mask);
+	xc->ring.cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	xc->ring.entries = params.sq_entries;
+	xc->ring.inFlight = 0;
+	pthread_mutex_init(&xc->ring.lock, NULL);
+
+	preadOpen(xc);
+}
+
+// Copies a block into the block structure through the block cache, waiting for the
+// line's asynchronous read if one is in flight
+void uringRead(struct xcheck* xc, uint index, struct block* b){
+	long tag = index / BLOCKS_PER_LINE(xc);
+	struct cacheLine* line = &xc->cache[tag % CACHE_LINES];
+
+	pthread_mutex_lock(&line->lock);
+	while(atomic_load(&line->pending))
+		uringReap(xc, 1);
+
+	preadFill(xc, line, tag);
+	memcpy(b->buf, &line->data[(index % BLOCKS_PER_LINE(xc)) * xc->blockSize], xc->blockSize);
+	pthread_mutex_unlock(&line->lock);
+
+	b->data = b->buf;
+}
+
+// Submits asynchronous reads of the cache lines holding a run of blocks. Lines which
+// are already cached or being read are skipped. Once queueDepth reads are in flight,
+// completions are reaped to make room.
+void uringAdvise(struct xcheck* xc, uint start, uint count, int advice){
+	(void)advice;
+	long tag, last = ((long)start + count - 1) / BLOCKS_PER_LINE(xc);
+	for(tag = start / BLOCKS_PER_LINE(xc); tag <= last; tag++){
+		struct cacheLine* line = &xc->cache[tag % CACHE_LINES];
+
+		pthread_mutex_lock(&line->lock);
+		if(line->tag == tag || atomic_load(&line->pending)){
+			pthread_mutex_unlock(&line->lock);
+			continue;
+		}
+
+		// Claim the line for the read
+		line->tag = tag;
+		atomic_store(&line->pending, 1);
+
+		pthread_mutex_lock(&xc->ring.lock);
+		while(xc->ring.inFlight >= xc->queueDepth || xc->ring.inFlight >= xc->ring.entries){
+			pthread_mutex_unlock(&xc->ring.lock);
+			uringReap(xc, 1);
+			pthread_mutex_lock(&xc->ring.lock);
+		}
+
+		uint sqTail = *xc->ring.sqTail;
+		uint idx = sqTail & *xc->ring.sqMask;
+		struct io_uring_sqe* sqe = &xc->ring.sqes[idx];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = xc->fd;
+		sqe->off = (unsigned long long)tag * CACHE_LINE_SIZE;
+		sqe->addr = (unsigned long long)(uintptr_t)line->data;
+		sqe->len = CACHE_LINE_SIZE;
+		sqe->user_data = tag % CACHE_LINES;
+		xc->ring.sqArray[idx] = idx;
+		atomic_store_explicit((_Atomic uint*)xc->ring.sqTail, sqTail + 1, memory_order_release);
+
+		if(syscall(__NR_io_uring_enter, xc->ring.fd, 1, 0, 0, NULL, 0) < 0){
+			// The read never started, so leave the line to be read synchronously
+			line->tag = -1;
+			atomic_store(&line->pending, 0);
+			atomic_store_explicit((_Atomic uint*)xc->ring.sqTail, sqTail, memory_order_release);
+		} else{
+			xc->ring.inFlight++;
+		}
+		pthread_mutex_unlock(&xc->ring.lock);
+
+		pthread_mutex_unlock(&line->lock);
+	}
+}
+
+// Consumes completed reads, waiting for at least wait of them. A failed or short read
+// leaves the rest of its line zeroed, or empty if nothing was read.
+void uringReap(struct xcheck* xc, int wait){
+	pthread_mutex_lock(&xc->ring.lock);
+	if(xc->ring.inFlight == 0){
+		pthread_mutex_unlock(&xc->ring.lock);
+		return;
+	}
+
+	uint head = *xc->ring.cqHead;
+	if(wait && head == atomic_load_explicit((_Atomic uint*)xc->ring.cqTail, memory_order_acquire))
+		syscall(__NR_io_uring_enter, xc->ring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+	while(head != atomic_load_explicit((_Atomic uint*)xc->ring.cqTail, memory_order_acquire)){
+		struct io_uring_cqe* cqe = &xc->ring.cqes[head & *xc->ring.cqMask];
+		struct cacheLine* line = &xc->cache[cqe->user_data];
+
+		if(cqe->res < 0)
+			line->tag = -1;
+		else if(cqe->res < CACHE_LINE_SIZE)
+			memset(line->data + cqe->res, 0, CACHE_LINE_SIZE - cqe->res);
+
+		atomic_store(&line->pending, 0);
+		xc->ring.inFlight--;
+		head++;
+	}
+	atomic_store_explicit((_Atomic uint*)xc->ring.cqHead, head, memory_order_release);
+
+	pthread_mutex_unlock(&xc->ring.lock);
+}
+
+// Waits for the reads in flight, which may have read the image before it changed,
+// then empties the block cache
+void uringReload(struct xcheck* xc){
+	while(xc->ring.inFlight > 0)
+		uringReap(xc, 1);
+
+	preadReload(xc);
+}
+
+// Waits for the reads in flight, then tears down the ring and block cache
+void uringClose(struct xcheck* xc){
+	while(xc->ring.inFlight > 0)
+		uringReap(xc, 1);
+
+	munmap(xc->ring.sqes, xc->ring.sqesSize);
+	if(xc->ring.cqRing != xc->ring.sqRing)
+		munmap(xc->ring.cqRing, xc->ring.cqRingSize);
+	munmap(xc->ring.sqRing, xc->ring.sqRingSize);
+	close(xc->ring.fd);
+	pthread_mutex_destroy(&xc->ring.lock);
+
+	preadClose(xc);
+}
+#endif
+
+// ***
+// *
+// *   Debug Functions
+// *
+// ***
+
+// Dumps a directory's data to the command line
+void debugDumpDir(struct xcheck* xc, uint inum){
+	uint perBlock = xc->blockSize / sizeof(struct dirent);
+	uint entries = directoryEntries(xc, xc->index.size[inum]);
+
+	printf("----- DIR DATA -----\n");
+
+	uint first;
+	for(first = 0; first < entries; first += perBlock){
+		struct block b;
+		if(!directoryBlock(xc, inum, first / perBlock, &b))
+			continue;
+
+		struct dirent* dirData = (struct dirent*)b.data;
+		uint count = entries - first < perBlock ? entries - first : perBlock;
+
+		uint j;
+		for(j = 0; j < count; j++){
+			if(dirData[j].inum == 0)
+				continue;
+
+			printf("%u - '%.*s'\n", dirData[j].inum, DIRSIZ, dirData[j].name);
+		}
+	}
+}
+
+// Prints the individuals bits of a byte to the console
+void debugPrintByte(char byte){
+	int i;
+	for(i = 0; i < 8; i++){
+		printf("%d", ((byte >> (7 - i)) & 0x1));
+	}
+	printf("\n");
+}
+
+// Dumps a block's data to the command line, with MAX to control 
+// amount of data dumped                                         
+void debugDumpBlock(struct block b, int MAX){
+	int i;
+	for(i = 0; i < MAX; i++){
+		printf("[%d]\n", b.data[i]);
+	}
+}
+
+void cleanup(struct xcheck* xc){
+	//free(inodes);
+	//free(superBlock);
+	resetChecks(xc);
+	freeIndex(xc);
+	free(xc->findings);
+	free(xc->statePath);
+	free(xc->overlay);
+
+	if(xc->sourceOpen)
+		xc->source->close(xc);
+	if(xc->fd >= 0)
+		close(xc->fd);
+}
+
@@ -0,0 +1,704 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "types_defs.h"
+#include "fs_defs.h"
+
+// Generates xv6 file system images for testing and benchmarking xcheck. The
+// tree, file sizes, hard links and block placement are all drawn from a seeded
+// generator, so the same arguments always produce the same image. Images are
+// valid unless a corruption is requested with -c.
+
+// Constants
+#define T_DIR 1
+#define T_FILE 2
+
+#define DIRENTS_PB (BLOCK_BYTES / sizeof(struct dirent))
+#define MAX_DIRENTS (MAX_BLOCKS * DIRENTS_PB)
+
+// Corruptions which can be applied to a generated image
+#define C_NONE 0
+#define C_BADINODE 1
+#define C_BADDIRECT 2
+#define C_BADINDIRECT 3
+#define C_BADROOT 4
+#define C_BADFMT 5
+#define C_MRKFREE 6
+#define C_MRKUSED 7
+#define C_ADDRONCE 8
+
+// Parameters of the image to generate
+struct params {
+	uint size;          // Blocks in the image
+	uint ninodes;       // Inodes in the inode table, 0 to fit the tree
+	uint nfiles;        // Regular files to create
+	uint fanout;        // Files and subdirectories per directory
+	double linkRatio;   // Extra hard links per file
+	double frag;        // Chance each block is placed randomly rather than next
+	int sizeDist;       // 'u' for uniform, 'e' for exponential file sizes
+	uint sizeA;         // Minimum size for 'u', mean size for 'e', in bytes
+	uint sizeB;         // Maximum size for 'u'
+	int corruption;     // One of the C_* codes
+	const char* layout; // Block size and addressing, named as xcheck --layout names them
+	uint nlog;          // Blocks in the log of the newer layout, 0 for the older one
+	uint pending;       // Blocks left committed in the log, but not installed
+	unsigned long long seed;
+};
+
+// A directory being built, and the entries it will hold
+struct dirBuild {
+	uint inum;
+	uint count;
+	uint capacity;
+	struct dirent* entries;
+};
+
+// Prototypes
+void usage();
+void parseSize(char*, struct params*);
+int parseCorruption(char*);
+void parseLayout(const char*);
+void generate(struct params*);
+uint allocBlock();
+void setBit(uint);
+void clearBit(uint);
+int getBit(uint);
+void addEntry(struct dirBuild*, uint, const char*);
+void writeFile(struct dinode*, uint);
+void writeDir(struct dirBuild*);
+void placeBlock(struct dinode*, uint, uint);
+void writeIndirect(struct dinode*, uint);
+void writeBlock(uint, void*);
+void corrupt(int);
+void pendLog(uint);
+uint fileSize();
+unsigned long long nextRand();
+double randUnit();
+void removeImage();
+
+// File descriptor and path of the image being written. The path is cleared once
+// the image is complete, so a failed run leaves no partial image behind.
+int FD;
+const char* IMAGE_PATH;
+
+// Layout of the image: its block size, the direct addresses of an inode, and whether
+// the address after its indirect block is a doubly indirect block
+uint BLOCK_BYTES;
+uint NDIR;
+uint DEPTH;
+uint NIND;
+unsigned long MAX_BLOCKS;
+
+// Geometry of the image. Data blocks are allocated from DATA_OFFSET up to DATA_END.
+uint SIZE;
+uint NBLOCKS;
+uint NINODES;
+uint NLOG;
+uint INODE_START;
+uint BMAP_START;
+uint BMAP_BLOCKS;
+uint DATA_OFFSET;
+uint DATA_END;
+
+// The inode table and bitmap, written out once the tree is built
+struct dinode* INODES;
+uchar* BMAP;
+
+// What the indirect blocks of the file being written list: its indirect block, its
+// doubly indirect block, and the indirect blocks under that one, end to end
+uint* SINGLE;
+uint* DOUBLE;
+uint* UNDER;
+
+// The next block to allocate when placing sequentially
+uint CURSOR;
+
+// Chance of placing each block randomly
+double FRAG;
+
+// File size distribution
+struct params* PARAMS;
+
+// State of the random number generator
+unsigned long long RNG;
+
+int main(int argc, char* argv[]){
+	struct params p;
+	memset(&p, 0, sizeof(p));
+	p.fanout = 16;
+	p.sizeA = 0;
+	p.seed = 1;
+	p.layout = "512";
+
+	// Parse the options
+	int opt;
+	while((opt = getopt(argc, argv, "b:i:n:d:l:f:z:c:s:g:N:P:")) != -1){
+		switch(opt){
+		case 'b': p.size = strtoul(optarg, NULL, 10); break;
+		case 'i': p.ninodes = strtoul(optarg, NULL, 10); break;
+		case 'n': p.nfiles = strtoul(optarg, NULL, 10); break;
+		case 'd': p.fanout = strtoul(optarg, NULL, 10); break;
+		case 'l': p.linkRatio = atof(optarg); break;
+		case 'f': p.frag = atof(optarg); break;
+		case 'z': parseSize(optarg, &p); break;
+		case 'c': p.corruption = parseCorruption(optarg); break;
+		case 's': p.seed = strtoull(optarg, NULL, 10); break;
+		case 'g': p.layout = optarg; break;
+		case 'N': p.nlog = strtoul(optarg, NULL, 10); break;
+		case 'P': p.pending = strtoul(optarg, NULL, 10); break;
+		default: usage();
+		}
+	}
+
+	// Files are up to 8 blocks unless told otherwise
+	parseLayout(p.layout);
+	if(p.sizeDist == 0){
+		p.sizeDist = 'u';
+		p.sizeB = 8 * BLOCK_BYTES;
+	}
+
+	if(optind != argc - 1 || p.size < 64 || p.fanout < 1 || p.fanout > MAX_DIRENTS - 2)
+		usage();
+
+	// The log header lists the pending blocks, which the log holds after it
+	if(p.pending > 0 && (p.pending >= p.nlog || p.pending >= BLOCK_BYTES / sizeof(int)))
+		usage();
+
+	FD = open(argv[optind], O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(FD < 0){
+		fprintf(stderr, "ERROR: could not create image\n");
+		exit(1);
+	}
+	IMAGE_PATH = argv[optind];
+	atexit(removeImage);
+
+	generate(&p);
+
+	close(FD);
+	IMAGE_PATH = NULL;
+	exit(0);
+}
+
+// Removes the image if it was left incomplete by an error exit
+void removeImage(){
+	if(IMAGE_PATH != NULL)
+		unlink(IMAGE_PATH);
+}
+
+// Prints how to run the generator, and exits
+void usage(){
+	fprintf(stderr, "Usage: mkimage -b blocks [-i inodes] [-n files] [-d fanout] [-l link_ratio]\n"
+		"               [-f fragmentation] [-z u:min:max|e:mean] [-c corruption] [-s seed] [-g layout]\n"
+		"               [-N log_blocks [-P pending]] <image>\n"
+		"Corruptions: badinode baddirect badindirect badroot badfmt mrkfree mrkused addronce\n"
+		"Layouts: 512 1k 4k 512-double 1k-double 4k-double\n");
+	exit(1);
+}
+
+// Parses a file size distribution, u:min:max or e:mean, in bytes
+void parseSize(char* arg, struct params* p){
+	if(sscanf(arg, "u:%u:%u", &p->sizeA, &p->sizeB) == 2 && p->sizeA <= p->sizeB){
+		p->sizeDist = 'u';
+	} else if(sscanf(arg, "e:%u", &p->sizeA) == 1){
+		p->sizeDist = 'e';
+	} else{
+		usage();
+	}
+}
+
+// Returns the C_* code for a corruption name
+int parseCorruption(char* name){
+	const char* names[] = { "none", "badinode", "baddirect", "badindirect", "badroot",
+		"badfmt", "mrkfree", "mrkused", "addronce", NULL };
+
+	int i;
+	for(i = 0; names[i] != NULL; i++){
+		if(strcmp(names[i], name) == 0)
+			return i;
+	}
+
+	usage();
+	return C_NONE;
+}
+
+// Sets the layout from its name: the block size, with a -double suffix if the last
+// address of an inode is a doubly indirect block, which takes the last direct one's place
+void parseLayout(const char* name){
+	const char* names[] = { "512", "1k", "4k", "512-double", "1k-double", "4k-double", NULL };
+	const uint sizes[] = { 512, 1024, 4096 };
+
+	int i;
+	for(i = 0; names[i] != NULL && strcmp(names[i], name) != 0; i++);
+	if(names[i] == NULL)
+		usage();
+
+	BLOCK_BYTES = sizes[i % 3];
+	DEPTH = i < 3 ? 1 : 2;
+	NDIR = DEPTH == 2 ? NDIRECT - 1 : NDIRECT;
+	NIND = BLOCK_BYTES / sizeof(uint);
+	MAX_BLOCKS = NDIR + NIND + (DEPTH == 2 ? (unsigned long)NIND * NIND : 0);
+}
+
+// ***
+// *
+// *   Generation functions
+// *
+// ***
+
+// Lays out the image, builds the directory tree and files, applies any corruption,
+// and writes the metadata out
+void generate(struct params* p){
+	PARAMS = p;
+	RNG = p->seed * 0x9E3779B97F4A7C15ULL + 1;
+	FRAG = p->frag;
+
+	// One directory for every fanout files, arranged as a tree with the same fanout
+	uint ndirs = 1 + p->nfiles / p->fanout;
+
+	// Fit the inode table to the tree unless told otherwise
+	uint ipb = BLOCK_BYTES / sizeof(struct dinode);
+	NINODES = p->ninodes;
+	if(NINODES == 0)
+		NINODES = (ndirs + p->nfiles + 2 + ipb - 1) / ipb * ipb;
+	if(NINODES < ndirs + p->nfiles + 2){
+		fprintf(stderr, "ERROR: %u inodes can't hold %u directories and %u files\n", NINODES, ndirs, p->nfiles);
+		exit(1);
+	}
+
+	// Directory entries hold 16 bit inode numbers
+	if(ndirs + p->nfiles + 2 > 65536){
+		fprintf(stderr, "ERROR: %u directories and %u files need more inode numbers than directory entries can hold\n", ndirs, p->nfiles);
+		exit(1);
+	}
+
+	// Lay out the image as xcheck expects: boot block, super block, the log if the
+	// layout is the newer one, inodes, bitmap, data. The older layout only allocates
+	// data blocks below nblocks, which is the range xcheck accepts of it.
+	SIZE = p->size;
+	NLOG = p->nlog;
+	uint lastBlock = SIZE - 1;
+	INODE_START = 2 + NLOG;
+	BMAP_START = INODE_START + NINODES / ipb + 1;
+	BMAP_BLOCKS = lastBlock / (BLOCK_BYTES * 8) + 1;
+	DATA_OFFSET = BMAP_START + BMAP_BLOCKS;
+	if(DATA_OFFSET + 2 > SIZE){
+		fprintf(stderr, "ERROR: %u blocks can't hold the inode table and bitmap\n", SIZE);
+		exit(1);
+	}
+	NBLOCKS = SIZE - DATA_OFFSET;
+	DATA_END = NLOG > 0 ? SIZE : NBLOCKS;
+
+	INODES = calloc(NINODES, sizeof(struct dinode));
+	BMAP = calloc(BMAP_BLOCKS, BLOCK_BYTES);
+	SINGLE = calloc(NIND, sizeof(uint));
+	DOUBLE = calloc(NIND, sizeof(uint));
+	UNDER = DEPTH == 2 ? calloc((size_t)NIND * NIND, sizeof(uint)) : NULL;
+	struct dirBuild* dirs = calloc(ndirs, sizeof(struct dirBuild));
+	if(INODES == NULL || BMAP == NULL || SINGLE == NULL || DOUBLE == NULL || (DEPTH == 2 && UNDER == NULL) || dirs == NULL){
+		fprintf(stderr, "ERROR: out of memory\n");
+		exit(1);
+	}
+
+	if(ftruncate(FD, (off_t)SIZE * BLOCK_BYTES) < 0){
+		fprintf(stderr, "ERROR: could not size image\n");
+		exit(1);
+	}
+
+	// The metadata blocks are in use
+	uint i;
+	for(i = 0; i < DATA_OFFSET; i++){
+		setBit(i);
+	}
+	CURSOR = DATA_OFFSET;
+
+	// Create the directories, the first being the root
+	for(i = 0; i < ndirs; i++){
+		dirs[i].inum = ROOTINO + i;
+
+		uint parent = i == 0 ? 0 : (i - 1) / p->fanout;
+		addEntry(&dirs[i], dirs[i].inum, ".");
+		addEntry(&dirs[i], dirs[parent].inum, "..");
+		INODES[dirs[i].inum].type = T_DIR;
+		INODES[dirs[i].inum].nlink = 1;
+
+		if(i > 0){
+			char name[DIRSIZ];
+			snprintf(name, DIRSIZ, "d%u", i);
+			addEntry(&dirs[parent], dirs[i].inum, name);
+		}
+	}
+
+	// Create the files, spread across the directories
+	uint firstFile = ROOTINO + ndirs;
+	for(i = 0; i < p->nfiles; i++){
+		uint inum = firstFile + i;
+		INODES[inum].type = T_FILE;
+		INODES[inum].nlink = 1;
+		writeFile(&INODES[inum], fileSize());
+
+		char name[DIRSIZ];
+		snprintf(name, DIRSIZ, "f%u", i);
+		addEntry(&dirs[i % ndirs], inum, name);
+	}
+
+	// Add hard links to random files from random directories
+	uint nlinks = (uint)(p->linkRatio * p->nfiles);
+	for(i = 0; i < nlinks && p->nfiles > 0; i++){
+		uint inum = firstFile + nextRand() % p->nfiles;
+		struct dirBuild* dir = &dirs[nextRand() % ndirs];
+		if(dir->count == MAX_DIRENTS)
+			continue;
+
+		char name[DIRSIZ];
+		snprintf(name, DIRSIZ, "l%u", i);
+		addEntry(dir, inum, name);
+		INODES[inum].nlink++;
+	}
+
+	// Write the directories out
+	for(i = 0; i < ndirs; i++){
+		writeDir(&dirs[i]);
+	}
+	free(dirs);
+
+	corrupt(p->corruption);
+
+	// Write the super block, inode table and bitmap
+	uchar sb[BLOCK_BYTES];
+	memset(sb, 0, BLOCK_BYTES);
+	struct superblock* super = (struct superblock*)sb;
+	super->size = SIZE;
+	super->nblocks = NBLOCKS;
+	super->ninodes = NINODES;
+	if(NLOG > 0){
+		super->nlog = NLOG;
+		super->logstart = 2;
+		super->inodestart = INODE_START;
+		super->bmapstart = BMAP_START;
+	}
+	writeBlock(1, sb);
+
+	if(pwrite(FD, INODES, (size_t)NINODES * sizeof(struct dinode), (off_t)INODE_START * BLOCK_BYTES) < 0 ||
+	   pwrite(FD, BMAP, (size_t)BMAP_BLOCKS * BLOCK_BYTES, (off_t)BMAP_START * BLOCK_BYTES) < 0){
+		fprintf(stderr, "ERROR: could not write image\n");
+		exit(1);
+	}
+
+	pendLog(p->pending);
+
+	printf("%u blocks, %u inodes, %u directories, %u files, %u links, %u blocks used\n",
+		SIZE, NINODES, ndirs, p->nfiles, nlinks, CURSOR - DATA_OFFSET);
+
+	free(INODES);
+	free(BMAP);
+	free(SINGLE);
+	free(DOUBLE);
+	free(UNDER);
+}
+
+// Allocates a data block. Blocks are placed one after another, except that with
+// probability FRAG a block is placed at a random free position instead. Only blocks
+// below DATA_END are used.
+uint allocBlock(){
+	uint span = DATA_END - DATA_OFFSET;
+	uint b = CURSOR;
+	if(FRAG > 0 && randUnit() < FRAG)
+		b = DATA_OFFSET + nextRand() % span;
+
+	// Find the next free block from there, wrapping around once
+	uint tries;
+	for(tries = 0; tries < span; tries++){
+		if(b >= DATA_END)
+			b = DATA_OFFSET;
+		if(!getBit(b))
+			break;
+		b++;
+	}
+
+	if(tries == span){
+		fprintf(stderr, "ERROR: image full\n");
+		exit(1);
+	}
+
+	setBit(b);
+	if(b >= CURSOR)
+		CURSOR = b + 1;
+
+	return b;
+}
+
+// Marks block b in use in the bitmap
+void setBit(uint b){
+	BMAP[b / 8] |= 1 << (b % 8);
+}
+
+// Marks block b free in the bitmap
+void clearBit(uint b){
+	BMAP[b / 8] &= ~(1 << (b % 8));
+}
+
+// Returns 1 if block b is in use in the bitmap
+int getBit(uint b){
+	return (BMAP[b / 8] >> (b % 8)) & 0x1;
+}
+
+// Adds an entry to a directory being built
+void addEntry(struct dirBuild* dir, uint inum, const char* name){
+	if(dir->count == MAX_DIRENTS){
+		fprintf(stderr, "ERROR: directory %u is full\n", dir->inum);
+		exit(1);
+	}
+
+	// Grow the entries as the directory fills
+	if(dir->count == dir->capacity){
+		dir->capacity = dir->capacity == 0 ? 64 : 2 * dir->capacity;
+		dir->entries = realloc(dir->entries, (size_t)dir->capacity * sizeof(struct dirent));
+		if(dir->entries == NULL){
+			fprintf(stderr, "ERROR: out of memory\n");
+			exit(1);
+		}
+	}
+
+	dir->entries[dir->count].inum = inum;
+	memset(dir->entries[dir->count].name, 0, DIRSIZ);
+	memcpy(dir->entries[dir->count].name, name, strnlen(name, DIRSIZ));
+	dir->count++;
+}
+
+// Allocates the blocks for a file of the given size, filling them with a pattern
+void writeFile(struct dinode* inode, uint size){
+	inode->size = size;
+
+	uint nblocks = (size + BLOCK_BYTES - 1) / BLOCK_BYTES;
+	uchar data[BLOCK_BYTES];
+	uint i;
+	for(i = 0; i < nblocks; i++){
+		uint b = allocBlock();
+		placeBlock(inode, i, b);
+
+		memset(data, (uchar)b, BLOCK_BYTES);
+		writeBlock(b, data);
+	}
+
+	writeIndirect(inode, nblocks);
+}
+
+// Allocates blocks for a directory and writes its entries into them
+void writeDir(struct dirBuild* dir){
+	struct dinode* inode = &INODES[dir->inum];
+	uint size = dir->count * sizeof(struct dirent);
+	uint nblocks = (size + BLOCK_BYTES - 1) / BLOCK_BYTES;
+	inode->size = size;
+
+	uchar data[BLOCK_BYTES];
+	uint i;
+	for(i = 0; i < nblocks; i++){
+		uint b = allocBlock();
+		placeBlock(inode, i, b);
+
+		// Copy this block's share of the entries, zeroing the rest
+		memset(data, 0, BLOCK_BYTES);
+		uint first = i * DIRENTS_PB;
+		uint n = dir->count - first < DIRENTS_PB ? dir->count - first : DIRENTS_PB;
+		memcpy(data, &dir->entries[first], n * sizeof(struct dirent));
+		writeBlock(b, data);
+	}
+
+	writeIndirect(inode, nblocks);
+	free(dir->entries);
+}
+
+// Records block b as the nth block of a file. An indirect block is allocated after the
+// first block it lists.
+void placeBlock(struct dinode* inode, uint nth, uint b){
+	if(nth < NDIR){
+		inode->addrs[nth] = b;
+		return;
+	}
+
+	nth -= NDIR;
+	if(nth < NIND){
+		if(nth == 0)
+			inode->addrs[NDIR] = allocBlock();
+		SINGLE[nth] = b;
+		return;
+	}
+
+	// Past the indirect block, the doubly indirect block lists an indirect block for
+	// each run of NIND blocks
+	nth -= NIND;
+	if(nth == 0)
+		inode->addrs[NDIR + 1] = allocBlock();
+	if(nth % NIND == 0)
+		DOUBLE[nth / NIND] = allocBlock();
+	UNDER[nth] = b;
+}
+
+// Writes out the indirect blocks of a file of nblocks blocks, once its blocks are placed,
+// and clears what they list for the next file
+void writeIndirect(struct dinode* inode, uint nblocks){
+	if(nblocks <= NDIR)
+		return;
+
+	writeBlock(inode->addrs[NDIR], SINGLE);
+	memset(SINGLE, 0, NIND * sizeof(uint));
+	if(nblocks <= NDIR + NIND)
+		return;
+
+	uint under = nblocks - NDIR - NIND;
+	uint i;
+	for(i = 0; i < (under + NIND - 1) / NIND; i++){
+		writeBlock(DOUBLE[i], &UNDER[(size_t)i * NIND]);
+	}
+	memset(UNDER, 0, (size_t)under * sizeof(uint));
+
+	writeBlock(inode->addrs[NDIR + 1], DOUBLE);
+	memset(DOUBLE, 0, NIND * sizeof(uint));
+}
+
+// Writes a block of data to the image
+void writeBlock(uint b, void* data){
+	if(pwrite(FD, data, BLOCK_BYTES, (off_t)b * BLOCK_BYTES) != BLOCK_BYTES){
+		fprintf(stderr, "ERROR: could not write image\n");
+		exit(1);
+	}
+}
+
+// Applies a corruption to the generated image, choosing its target at random
+void corrupt(int corruption){
+	if(corruption == C_NONE)
+		return;
+
+	// Find a file to corrupt, preferring one with the blocks the corruption needs
+	uint inum, target = 0, other = 0;
+	for(inum = ROOTINO + 1; inum < NINODES; inum++){
+		if(INODES[inum].type != T_FILE || INODES[inum].addrs[0] == 0)
+			continue;
+
+		if(corruption == C_BADINDIRECT && INODES[inum].addrs[NDIR] == 0)
+			continue;
+
+		if(target == 0)
+			target = inum;
+		else if(other == 0)
+			other = inum;
+
+		// Spread the choice around the table
+		if(other != 0 && nextRand() % 4 == 0)
+			break;
+	}
+
+	if(target == 0 || (corruption == C_ADDRONCE && other == 0)){
+		fprintf(stderr, "ERROR: no file to apply the corruption to\n");
+		exit(1);
+	}
+
+	struct dinode* inode = &INODES[target];
+	uchar data[BLOCK_BYTES];
+
+	switch(corruption){
+	case C_BADINODE:
+		inode->type = 7;
+		break;
+	case C_BADDIRECT:
+		inode->addrs[0] = SIZE + 10;
+		break;
+	case C_BADINDIRECT:
+		pread(FD, data, BLOCK_BYTES, (off_t)inode->addrs[NDIR] * BLOCK_BYTES);
+		((uint*)data)[0] = SIZE + 10;
+		writeBlock(inode->addrs[NDIR], data);
+		break;
+	case C_BADROOT:
+		pread(FD, data, BLOCK_BYTES, (off_t)INODES[ROOTINO].addrs[0] * BLOCK_BYTES);
+		((struct dirent*)data)[1].inum = ROOTINO + 1;
+		writeBlock(INODES[ROOTINO].addrs[0], data);
+		break;
+	case C_BADFMT:
+		pread(FD, data, BLOCK_BYTES, (off_t)INODES[ROOTINO].addrs[0] * BLOCK_BYTES);
+		strncpy(((struct dirent*)data)[0].name, "x", DIRSIZ);
+		writeBlock(INODES[ROOTINO].addrs[0], data);
+		break;
+	case C_MRKFREE:
+		clearBit(inode->addrs[0]);
+		break;
+	case C_MRKUSED:
+		for(inum = DATA_OFFSET + 1; inum < DATA_END && getBit(inum); inum++);
+		if(inum == DATA_END){
+			fprintf(stderr, "ERROR: no free block to mark used\n");
+			exit(1);
+		}
+		setBit(inum);
+		break;
+	case C_ADDRONCE:
+		clearBit(INODES[other].addrs[0]);
+		INODES[other].addrs[0] = inode->addrs[0];
+		break;
+	}
+}
+
+// Leaves the first blocks of the inode table, and those after it, committed in the log
+// but not installed: the log holds their contents, and they are zeroed where they
+// belong. The image is only consistent once the log is replayed.
+void pendLog(uint pending){
+	if(pending == 0)
+		return;
+
+	uchar header[BLOCK_BYTES];
+	memset(header, 0, BLOCK_BYTES);
+	struct logheader* log = (struct logheader*)header;
+	log->n = pending;
+
+	uchar data[BLOCK_BYTES];
+	uchar zero[BLOCK_BYTES];
+	memset(zero, 0, BLOCK_BYTES);
+
+	uint i;
+	for(i = 0; i < pending && INODE_START + i < SIZE; i++){
+		uint b = INODE_START + i;
+		log->block[i] = b;
+
+		if(pread(FD, data, BLOCK_BYTES, (off_t)b * BLOCK_BYTES) != BLOCK_BYTES){
+			fprintf(stderr, "ERROR: could not read image\n");
+			exit(1);
+		}
+		writeBlock(3 + i, data);
+		writeBlock(b, zero);
+	}
+	log->n = i;
+
+	writeBlock(2, header);
+}
+
+// Draws a file size in bytes from the requested distribution, capped at the largest file
+// the layout addresses
+uint fileSize(){
+	double size;
+	if(PARAMS->sizeDist == 'e')
+		size = -log(1.0 - randUnit()) * PARAMS->sizeA;
+	else
+		size = PARAMS->sizeA + (double)(nextRand() % ((unsigned long long)PARAMS->sizeB - PARAMS->sizeA + 1));
+
+	if(size > (double)MAX_BLOCKS * BLOCK_BYTES)
+		size = (double)MAX_BLOCKS * BLOCK_BYTES;
+	if(size > 0xFFFFFFFFu)
+		size = 0xFFFFFFFFu;
+
+	return (uint)size;
+}
+
+// Returns the next number from an xorshift64* generator
+unsigned long long nextRand(){
+	RNG ^= RNG >> 12;
+	RNG ^= RNG << 25;
+	RNG ^= RNG >> 27;
+	return RNG * 0x2545F4914F6CDD1DULL;
+}
+
+// Returns a random number in [0, 1)
+double randUnit(){
+	return (nextRand() >> 11) * (1.0 / 9007199254740992.0);
+}
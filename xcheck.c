@@ -1,761 +1,930 @@
 #include <stdio.h>
-#include <fcntl.h>
 #include <stdlib.h>
-#include <sys/mman.h>
 #include <string.h>
+#include <getopt.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
 #include <unistd.h>
-
-#include "types_defs.h"
-#include "fs_defs.h"
-
-// Constants
-#define BLOCK_SIZE 512
-#define ROOT_INO 1
-#define INODE_PB (BLOCK_SIZE / sizeof(struct dinode))
-
-#define T_UNALLOC 0
-#define T_DIR 1
-#define T_FILE 2
-#define T_DEV 3
-
-// Data structure for on-disk block
-struct block {
-	char* data;
-};                 
-
-// Analysis prototypes
-int indirectAddressTest();
-int directAddressTest();
-int directoryTest();
-int rootTest();
-int inodesValidTest();
-int inodesAddressTest();
-int bitmapInInodesTest();
-int inodesInBitmapTest();
-
-// Basic utility prototypes
-int uniqueAddr(uint*, int);
-int dirCheck(uint, uint);
-int validDirect(struct dinode*, uint);
-int validAddresses(struct dinode*);
-int blockInInodes(int);
-int inodeInBitmap(struct dinode*);
-int readLength(int);
-int blockInUse(int);
-int useableType(int);
-int validInode(struct dinode*);
-int blockBit(int);
-void bread(int, struct block*);
-void init(char*);
-int inode2Block(int);
-
-// Debug prototypes
-void debugDumpDir(struct dinode*);
-void debugPrintByte(char);
-void debugDumpBlock(struct block, int);
-void int2Binary(int, char[8]);
-void cleanup();
-
-// File descriptor of file system
-int FSFD;
-
-// Number of offset blocks to access the data block region
-int DATA_OFFSET;
-
-// The beginning address for the file system mapped into
-// the application
-char* FS_ADDR;
-
-// Super block of the file system
-struct superblock* SUPER_BLOCK;
-
-// Points to inodes in the file system
-struct dinode* INODES;
-
-// Points to the root directory entry
-struct dirent* ROOT_DIR;
-
-// The bitmap for which data blocks have been used
-char* BMAP;
+#include <sys/inotify.h>
+
+#include "xcheck.h"
+
+// State files are kept beside their image, with this suffix
+#define STATE_SUFFIX ".xcstate"
+
+// Milliseconds a watched image must go unwritten before it is checked, unless
+// --debounce says otherwise. An image written without a pause is checked anyway
+// once DEBOUNCE_LIMIT times that has passed since its first change.
+#define DEFAULT_DEBOUNCE 200
+#define DEBOUNCE_LIMIT 8
+
+// Prototypes
+void printFinding(void*, const struct xcheckFinding*);
+void reportGeometry(struct xcheck*, int);
+char* statePath(const char*);
+int findLevel(const char*);
+unsigned long parseSize(const char*);
+void statsReport(struct xcheck*, FILE*, const char*, int);
+void usage();
+
+// What the sink needs to print findings
+struct report {
+	int all;                // Findings are listed with their rule, inode and block
+	unsigned long printed;  // Findings printed so far
+};
+
+// A corpus of images checked by a pool of workers. Each worker holds one image open
+// at a time, so no more images are mapped at once than there are workers.
+struct batch {
+	char** images;
+	unsigned long nimages;
+	atomic_ulong next;                  // Next image for a worker to take
+	struct xcheckOptions options;       // How each image is checked
+	int state;                          // Keep a state file beside each image
+	pthread_mutex_t lock;               // Guards the output and the totals below
+	unsigned long passed;
+	unsigned long failed;               // Images breaking a rule
+	unsigned long unchecked;            // Images which couldn't be checked
+	unsigned long long bytes;           // Bytes in the images checked
+};
+
+// The first finding of an image, and how many there were
+struct tally {
+	unsigned int rule;
+	unsigned long found;
+};
+
+// An image in a watched directory. Its checker stays open between checks, so the
+// image stays mapped and its inode index allocated.
+struct watched {
+	char* name;                 // Name of the image in the directory
+	char* path;
+	char* sidecar;              // Its state file, if keeping state
+	struct xcheck* xc;          // Open checker, or NULL until the image is opened
+	int dirty;                  // Changed since the last verdict
+	int replaced;               // Created or moved in, so it must be opened anew
+	struct timespec changed;    // When the first change since the last verdict was seen
+	struct timespec written;    // When the last change was seen
+};
+
+// A directory whose images are checked again whenever they change
+struct watch {
+	const char* dir;
+	struct xcheckOptions options;   // How each image is checked
+	int state;                      // Keep a state file beside each image
+	int debounce;                   // Milliseconds to wait for writes to settle
+	struct watched* images;         // Sorted by name
+	unsigned long nimages;
+	unsigned long cap;
+};
+
+// Batch prototypes
+int runBatch(const char*, const struct xcheckOptions*, int, int);
+int loadBatch(const char*, char***, unsigned long*);
+int batchAdd(char***, unsigned long*, unsigned long*, char*);
+int batchEntry(const struct dirent*);
+void* batchWorker(void*);
+void checkImage(struct batch*, const char*);
+void noteFinding(void*, const struct xcheckFinding*);
+void printVerdict(const char*, struct xcheck*, int, const struct tally*, int, const char*);
+int imageName(const char*);
+
+// Watch prototypes
+int runWatch(const char*, const struct xcheckOptions*, int, int);
+void watchEvent(struct watch*, const struct inotify_event*, struct timespec*);
+struct watched* watchFind(struct watch*, const char*, int);
+void watchDrop(struct watch*, struct watched*);
+int watchCheck(struct watch*, struct watched*, struct timespec*);
+int watchNext(struct watch*, struct timespec*);
+int compareWatched(const void*, const void*);
+double elapsedMs(const struct timespec*, const struct timespec*);
+void stopWatch(int);
+
+// Set by a signal to stop watching
+volatile sig_atomic_t STOP_WATCH = 0;
 
 int main (int argc, char *argv[]){
-	// Check for valid arguments
-	if(argc < 2){
-		fprintf(stderr, "Usage: xcheck <file_system_image>\n"); 
-		exit(1);
+	// How the image is checked
+	struct xcheckOptions options;
+	memset(&options, 0, sizeof(options));
+	options.threads = 1;
+
+	// Whether to report the geometry and memory use
+	int verbose = 0;
+
+	// Where the stats are written, if anywhere
+	FILE* statsOut = NULL;
+
+	// Directory or list of images to check, if checking a batch
+	const char* batch = NULL;
+
+	// Directory to watch, if watching one, and how long writes take to settle
+	const char* watch = NULL;
+	int debounce = DEFAULT_DEBOUNCE;
+
+	// Whether to keep a state file, and where if not beside the image
+	int state = 0;
+	const char* stateFile = NULL;
+
+	// Long options
+	struct option longOpts[] = {
+		{ "stats", optional_argument, NULL, 'S' },
+		{ "all", optional_argument, NULL, 'A' },
+		{ "batch", required_argument, NULL, 'b' },
+		{ "state", optional_argument, NULL, 's' },
+		{ "full", no_argument, NULL, 'F' },
+		{ "level", required_argument, NULL, 'L' },
+		{ "memory", required_argument, NULL, 'M' },
+		{ "layout", required_argument, NULL, 'G' },
+		{ "watch", required_argument, NULL, 'W' },
+		{ "debounce", required_argument, NULL, 'D' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	// Parse the options
+	int opt;
+	while((opt = getopt_long(argc, argv, "j:vB:Q:", longOpts, NULL)) != -1){
+		if(opt == 'S'){
+			options.stats = 1;
+			statsOut = optarg != NULL ? fopen(optarg, "w") : stderr;
+			if(statsOut == NULL){
+				fprintf(stderr, "ERROR: could not open stats file\n");
+				exit(1);
+			}
+		} else if(opt == 'A' && (optarg == NULL || atol(optarg) > 0)){
+			options.all = 1;
+			if(optarg != NULL)
+				options.maxFindings = atol(optarg);
+		} else if(opt == 'b'){
+			batch = optarg;
+		} else if(opt == 'W'){
+			watch = optarg;
+		} else if(opt == 'D' && atoi(optarg) > 0){
+			debounce = atoi(optarg);
+		} else if(opt == 's'){
+			state = 1;
+			stateFile = optarg;
+		} else if(opt == 'F'){
+			options.full = 1;
+		} else if(opt == 'L' && findLevel(optarg) != 0){
+			options.level = findLevel(optarg);
+		} else if(opt == 'M' && parseSize(optarg) > 0){
+			options.memoryBudget = parseSize(optarg);
+		} else if(opt == 'G' && xcheckHasLayout(optarg)){
+			options.layout = optarg;
+		} else if(opt == 'j' && atoi(optarg) > 0){
+			options.threads = atoi(optarg);
+		} else if(opt == 'Q' && atoi(optarg) > 0){
+			options.queueDepth = atoi(optarg);
+		} else if(opt == 'v'){
+			verbose = 1;
+		} else if(opt == 'B' && xcheckHasSource(optarg)){
+			options.source = optarg;
+		} else{
+			usage();
+		}
 	}
 
-	// Initialize the file system in the application
-	init(argv[1]);
-
-	// Debugging block
-	/*
-	printf("Should output 1024: %u\n", SUPER_BLOCK->size);
-	debugDumpDir(&INODES[1]);
-	debugPrintByte(BMAP[51]);
-	printf("%d\n", DATA_OFFSET);
-	*/
-
-	// Run tests
-	if(!inodesValidTest()){
-		printf("ERROR: bad inode\n");
-		exit(1);
-	}
-	
-	if(!inodesAddressTest()){
-		exit(1);
-	}
+	// A batch takes no image of its own, has no single image to time, and keeps each
+	// image's state beside it
+	if(batch != NULL){
+		if(optind < argc || statsOut != NULL || stateFile != NULL)
+			usage();
 
-	if(!rootTest()){
-		printf("ERROR: root directory does not exit.\n");
-		exit(1);
+		exit(runBatch(batch, &options, options.threads, state));
 	}
 
-	if(!directoryTest()){
-		printf("ERROR: directory not properly formatted.\n");
-		exit(1);
-	}
+	// So does a watch, which runs until it is stopped
+	if(watch != NULL){
+		if(optind < argc || statsOut != NULL || stateFile != NULL)
+			usage();
 
-	if(!inodesInBitmapTest()){
-		printf("ERROR: address used by inode marked free in bitmap.\n");
-		exit(1);
+		exit(runWatch(watch, &options, state, debounce));
 	}
-	
-	if(!bitmapInInodesTest()){
-		printf("ERROR: bitmap marks block in use but it is not in use.\n");
-		exit(1);
+
+	// Check for valid arguments
+	if(optind >= argc)
+		usage();
+
+	// The state is kept beside the image unless given a file of its own
+	char* sidecar = NULL;
+	if(state){
+		sidecar = stateFile != NULL ? strdup(stateFile) : statePath(argv[optind]);
+		options.state = sidecar;
 	}
 
-	if(!directAddressTest()){
-		printf("ERROR: direct address used more than once.\n");
+	struct xcheck* xc = xcheckNew(&options);
+	if(xc == NULL){
+		fprintf(stderr, "ERROR: could not allocate checker\n");
 		exit(1);
 	}
 
-	if(!indirectAddressTest()){
-		printf("ERROR: indirect address used more than once.\n");
-		exit(1);
+	// Initialize the file system in the application
+	int result = xcheckOpen(xc, argv[optind]);
+
+	// Say so when the kernel couldn't give us io_uring
+	if(options.source != NULL && strcmp(options.source, xcheckSource(xc)) != 0)
+		fprintf(stderr, "xcheck: io_uring unavailable, using pread\n");
+
+	// Check every rule, or up to the first broken
+	struct report report = { options.all, 0 };
+	if(result == XCHECK_OK)
+		result = xcheckRun(xc, printFinding, &report);
+
+	if(verbose && result >= 0)
+		reportGeometry(xc, options.threads);
+
+	if(result < 0){
+		fprintf(stderr, "ERROR: %s\n", xcheckError(xc));
+	} else if(options.all){
+		// Summarize everything found at once
+		unsigned long found = xcheckFindings(xc);
+		if(found == 0)
+			printf("Check complete!\n");
+		else if(found > report.printed)
+			printf("%lu errors found, %lu not listed.\n", found, found - report.printed);
+		else
+			printf("%lu errors found.\n", found);
+	} else if(result == XCHECK_OK){
+		printf("Check complete!\n");
 	}
 
-	printf("Check complete!\n");
+	// The stats are written however the check ends
+	if(statsOut != NULL)
+		statsReport(xc, statsOut, argv[optind], options.threads);
 
-	cleanup();
-	exit(0);
+	xcheckFree(xc);
+	free(sidecar);
+	exit(result == XCHECK_OK ? 0 : 1);
 }
 
-// ***
-// *
-// *   Analysis functions
-// *
-// ***
-
-// Checks that all indirect addresses for in-use inodes are only referenced once within the redirect block of the inode.
-int indirectAddressTest(){
-	// Iterate through the inodes
-	int i;
-	for(i = 0; i < SUPER_BLOCK->ninodes; i++){
-		// If the inode is usable, examine it further
-		if(useableType(INODES[i].type)){
-			// Get the referenced blocks in the inode
-			uint* refBlocks = INODES[i].addrs;
-
-			// If the indirect block is unallocated, then don't worry about it
-			if(refBlocks[NDIRECT] == 0)
-				continue;
-
-			// Read the indirect block from the file system
-			struct block b;
-			bread(refBlocks[NDIRECT], &b);
-			uint* indirect = (uint*)b.data;
+// Prints a finding. Stopping at the first broken rule, only its message is printed,
+// as the checker always has.
+void printFinding(void* arg, const struct xcheckFinding* finding){
+	struct report* report = arg;
+	report->printed++;
 
-			// If the indirect block has repeated addresses within it, then return false
-			if(!uniqueAddr(indirect, readLength(INODES[i].size))){
-				return 0;
-			}
-		}
+	if(report->all){
+		printf("ERROR: %s [%s inode %u block %u]\n", xcheckRuleMessage(finding->rule),
+			xcheckRuleId(finding->rule), finding->inum, finding->block);
+		return;
 	}
 
-	// Otherwise, return 1
-	return 1;
-}
+	// Name both owners of a duplicated block
+	if(finding->rule == XCHECK_RULE_DUP_DIRECT || finding->rule == XCHECK_RULE_DUP_INDIRECT)
+		fprintf(stderr, "xcheck: block %u referenced by inode %u and inode %u\n",
+			finding->block, finding->firstInum, finding->inum);
 
-// Checks that all direct addresses for in-use inodes are only referenced once by each inode.
-// Links to the same blocks by other inodes allowed, in the event of hard linking on the file system
-int directAddressTest(){
-	// Iterate through the inodes
-	int i;
-	for(i = 0; i < SUPER_BLOCK->ninodes; i++){
-		// If the inode is usable, examine it further
-		if(useableType(INODES[i].type)){
-			// If the inode has non-unique block references, return false.
-			uint* refBlocks = INODES[i].addrs;
-			if(!uniqueAddr(refBlocks, NDIRECT + 1))
-				return 0;
-		}
-	}
-
-	// No repeated block references detected - return true
-	return 1;
+	printf("ERROR: %s\n", xcheckRuleMessage(finding->rule));
 }
 
-// Examines all directories, and determines that they are properly formatted
-int directoryTest(){
-	// Iterate through inodes
-	int i;
-	for(i = 0; i < SUPER_BLOCK->ninodes; i++){
-		// If the inode is a directory, examine it further
-		if(INODES[i].type == T_DIR){
-			// If not a valid directory, return false
-			if(!validDirect(&INODES[i], i))
-				return 0;
-		}
-	}
-
-	// All directories are valid - return true
-	return 1;
+// Reports the geometry of the file system and the memory used to check it
+void reportGeometry(struct xcheck* xc, int threads){
+	struct xcheckGeometry geometry;
+	xcheckGeometry(xc, &geometry);
+
+	fprintf(stderr, "xcheck: %s layout, %u blocks of %u bytes, %u inodes, %u bitmap blocks, data from block %u\n",
+		geometry.layout, geometry.size, geometry.blockSize, geometry.ninodes, geometry.bitmapBlocks, geometry.dataOffset);
+	if(geometry.logBlocks > 0)
+		fprintf(stderr, "xcheck: %u log blocks, inodes from block %u, %u committed blocks replayed\n",
+			geometry.logBlocks, geometry.inodeStart, geometry.logReplayed);
+
+	// Each sweep worker has a block map and a duplicate map until they are merged
+	double mapMiB = 2.0 * threads * geometry.mapBytes / (1024 * 1024);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	fprintf(stderr, "xcheck: %.1f MiB of block maps, %.1f MiB peak resident\n",
+		mapMiB, usage.ru_maxrss / 1024.0);
+
+	// Under a memory budget, the maps only cover a window of blocks at a time
+	if(geometry.windows > 1)
+		fprintf(stderr, "xcheck: %u windows of %u blocks\n", geometry.windows, geometry.windowBlocks);
+
+	// Whether the last verdict could be reused
+	unsigned int changed;
+	unsigned int regions = xcheckRegions(xc, &changed);
+	if(regions > 0)
+		fprintf(stderr, "xcheck: %u of %u regions changed since the last check%s\n",
+			changed, regions, changed == 0 ? ", verdict reused" : "");
 }
 
-// Examines the root directory, and returns 1 if it's data is correct. Return 0 otherwise.
-int rootTest(){
-	// / Realod the root inode based on expected data
-	struct dinode rootInode = INODES[ROOT_INO];
-
-	// Make sure the root inode is usable
-	if(!useableType(rootInode.type))
-		return 0;
+// Returns the XCHECK_LEVEL_* code of a named level, or 0 if there is none
+int findLevel(const char* name){
+	if(strcmp(name, "quick") == 0)
+		return XCHECK_LEVEL_QUICK;
+	if(strcmp(name, "standard") == 0)
+		return XCHECK_LEVEL_STANDARD;
+	if(strcmp(name, "deep") == 0)
+		return XCHECK_LEVEL_DEEP;
 
-	// The root shouldn't be empty
-	if(rootInode.size == 0)
-		return 0;
+	return 0;
+}
 
-	// The root inode should only use valid addresses
-	if(!validAddresses(&rootInode))
+// Returns the number of bytes in a size such as 512K, 64M or 2G, or 0 if it isn't one
+unsigned long parseSize(const char* size){
+	char* end;
+	unsigned long bytes = strtoul(size, &end, 10);
+	if(end == size)
 		return 0;
 
-	// The first address of the root inode shouldn't be empty
-	if(rootInode.addrs[0] == 0)
+	if(*end == 'K' || *end == 'k')
+		bytes <<= 10;
+	else if(*end == 'M' || *end == 'm')
+		bytes <<= 20;
+	else if(*end == 'G' || *end == 'g')
+		bytes <<= 30;
+	else if(*end != '\0')
 		return 0;
 
-	// Reload the root directory entry from the disk
-	struct block b;
-	bread(rootInode.addrs[0], &b);
-	struct dirent* root = (struct dirent*)b.data;
-
-	// If the reloaded directory entry doesn't match out init directory entry, there is a problem
-	if(root[0].inum != ROOT_DIR[0].inum)
-		return 0;
-	
-	// The '..' entry in the root directory should be equal to our ROOT_INO number of '1'
-	if(root[1].inum != ROOT_INO)
+	// Nothing may follow the unit
+	if(*end != '\0' && end[1] != '\0')
 		return 0;
 
-	// Root has passed all tests.
-	return 1;
+	return bytes;
 }
 
-// Returns 1 if all inodes are valid. 0 otherwise.
-int inodesValidTest(){
-	// Iterates through all inodes, and checks if they are valid
-	int i;
-	for(i = 0; i < SUPER_BLOCK->ninodes; i++){
-		// If the inode isn't valid, return 0 for failure.
-		if(!validInode(&INODES[i]))
-			return 0;
-	}
+// Returns the path of the state file kept beside an image
+char* statePath(const char* image){
+	char* path = malloc(strlen(image) + sizeof(STATE_SUFFIX));
+	if(path != NULL)
+		sprintf(path, "%s%s", image, STATE_SUFFIX);
 
-	// Success, all inodes are valid. Return 1
-	return 1;
+	return path;
 }
 
-// Returns 1 if all addresses referenced by useable inodes are valid. Returns 0 otherwise.
-int inodesAddressTest(){
-	// Iterates through all inodes, and checks if they have valid addresses
-	int i;
-	for(i = 0; i < SUPER_BLOCK->ninodes; i++){
-		// If the inode is useable, examine it further
-		if(useableType(INODES[i].type)){
-			// If the inode has invalid addresses, return 0
-			if(!validAddresses(&INODES[i])){
-				return 0;
-			}
-		}
-	}
+// Writes the timed stages as JSON
+void statsReport(struct xcheck* xc, FILE* out, const char* image, int threads){
+	fprintf(out, "{\"image\": \"%s\", \"source\": \"%s\", \"threads\": %d, \"stages\": [",
+		image, xcheckSource(xc), threads);
 
-	// Success, so return 1
-	return 1;
-}
+	const struct xcheckStage* stages;
+	int nstages = xcheckStages(xc, &stages);
 
-// Returns 1 if all blocks in the bitmap marked as in-use are referred to by some inode.
-// If not, returns 0
-int bitmapInInodesTest(){
-	// Iterate through the bits in the bitmap, beginning from the data block offset, and continue
-	// for the number of data blocks there are
 	int i;
-	for(i = DATA_OFFSET + 1; i < SUPER_BLOCK->nblocks + DATA_OFFSET; i++){
-		// If the bit for this block is marked as active, examine it further
-		if(blockBit(i)){
-			// If this block isn't in an inode, return 0
-			if(!blockInInodes(i)){
-				return 0;
-			}
-		}
+	for(i = 0; i < nstages; i++){
+		const struct xcheckStage* stage = &stages[i];
+		fprintf(out, "%s\n  {\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+			"\"inodes\": %lu, \"blocks_read\": %lu, \"minor_faults\": %ld, \"major_faults\": %ld}",
+			i == 0 ? "" : ",", stage->name, stage->wallMs, stage->cpuMs, stage->inodes,
+			stage->blocks, stage->minorFaults, stage->majorFaults);
 	}
 
-	// Success, so return 1
-	return 1;	
+	fprintf(out, "\n]}\n");
+	fflush(out);
 }
 
-// Returns 1 if for all in-use inodes, each block in use is also marked in-use by the
-// bitmap. Returns 0 if an inode is using a block which is not marked as in-use by the
-// bitmap.
-int inodesInBitmapTest(){
-	// Iterate through all the inodes
-	int i;
-	for(i = 0; i < SUPER_BLOCK->ninodes; i++){
-		// If the inode isn't usable, don't examine it
-		if(useableType(INODES[i].type)){
-			// If the inode's data blocks aren't marked as in-use by the bitmap, 
-			// return false
-			if(!inodeInBitmap(&INODES[i]))
-				return 0;
-		}
-	}
-	
-	// All inode data blocks are properly documented in the bitmap. This test
-	// has been passed, so return true
-	return 1;
+// Prints how to run the checker, and exits
+void usage(){
+	fprintf(stderr, "Usage: xcheck [-v] [--stats[=file]] [--all[=max]] [--state[=file]] [--full] [--level quick|standard|deep] [--memory size] [--layout name] [-j threads] [-B mmap|pread|direct|uring] [-Q depth] <file_system_image>\n");
+	fprintf(stderr, "       xcheck --batch <dir|listfile> [--all[=max]] [--state] [--full] [--level quick|standard|deep] [--memory size] [--layout name] [-j jobs] [-B mmap|pread|direct|uring] [-Q depth]\n");
+	fprintf(stderr, "       xcheck --watch <dir> [--debounce ms] [--all[=max]] [--state] [--full] [--level quick|standard|deep] [--memory size] [--layout name] [-j threads] [-B mmap|pread|direct|uring] [-Q depth]\n");
+	exit(1);
 }
 
 // ***
 // *
-// *   Utility functions
+// *   Batch functions
 // *
 // ***
 
-// Checks if the address list of length len has only unique addresses present
-int uniqueAddr(uint* addr, int len){
-	int i, j;
-	uint cur;
-
-	// Iterate through the list
-	for(i = 0; i < len; i++){
-		// Get a value to examine
-		cur = addr[i];
-
-		// If this block is unallocated, don't worry about it
-		if(cur == 0)
-			continue;
-
-		// Check that the value we're examining doesn't appear in the list again
-		for(j = 0; j < len; j++){
-			// If we're looking at the same entry, or this entry is unallocated,
-			// don't worry about it
-			if(j == i || addr[j] == 0)
-				continue;
+// Checks every image in a directory or list file with a pool of jobs workers, printing
+// a line per image as each finishes and the totals at the end. Each image is checked
+// with a single thread. Returns the exit status: 0 if every image passed.
+int runBatch(const char* path, const struct xcheckOptions* options, int jobs, int state){
+	struct batch batch;
+	memset(&batch, 0, sizeof(batch));
+	batch.options = *options;
+	batch.options.threads = 1;
+	batch.state = state;
+	pthread_mutex_init(&batch.lock, NULL);
+
+	if(!loadBatch(path, &batch.images, &batch.nimages)){
+		fprintf(stderr, "ERROR: could not read batch %s\n", path);
+		return 1;
+	}
 
-			// We've detected a duplicate address - return false
-			if(cur == addr[j])
-				return 0;
+	// There is no use for more workers than images
+	if((unsigned long)jobs > batch.nimages)
+		jobs = batch.nimages > 0 ? batch.nimages : 1;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// A single worker runs on the main thread. The images of a worker which can't
+	// be started are taken by the others.
+	pthread_t* workers = calloc(jobs, sizeof(pthread_t));
+	int started = 0;
+	if(jobs > 1 && workers != NULL){
+		for(started = 0; started < jobs; started++){
+			if(pthread_create(&workers[started], NULL, batchWorker, &batch) != 0)
+				break;
 		}
 	}
 
-	// No duplicate addresses found - return true
-	return 1;
-}
+	if(started == 0)
+		batchWorker(&batch);
 
-// Checks if the directory inode passed to it is properly defined
-int validDirect(struct dinode* inode, uint inum){
-	// Get the block addresses 
-	// We only need to examine the first block address
-	uint* refBlocks = inode->addrs;
+	int i;
+	for(i = 0; i < started; i++){
+		pthread_join(workers[i], NULL);
+	}
 
-	// If the first address, is zero, it is unallocated, and
-	// thus technically valid
-	if(refBlocks[0] == 0)
-		return 1;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	if(seconds <= 0)
+		seconds = 1e-9;
 
-	// Read the first address block
-	struct block b;
-	bread(refBlocks[0], &b);
+	printf("%lu images in %.3f s (%.1f images/s, %.1f MiB/s): %lu passed, %lu failed, %lu unchecked\n",
+		batch.nimages, seconds, batch.nimages / seconds, batch.bytes / seconds / (1024 * 1024),
+		batch.passed, batch.failed, batch.unchecked);
 
-	// Get the directory data
-	struct dirent* entry = (struct dirent*)b.data;
-	
-	// Check the first entry refers to '.'
-	if(strcmp(entry[0].name, ".") != 0)
-		return 0;
-	
-	// Check the second entry refers to '..'
-	if(strcmp(entry[1].name, "..") != 0)
-		return 0;
-	
-	// Check that the first entry's inode refers to this inoude object
-	if(entry[0].inum != inum)
-		return 0;
-
-	// All tests passed. Return true.
-	return 1;
+	unsigned long j;
+	for(j = 0; j < batch.nimages; j++){
+		free(batch.images[j]);
+	}
+	free(batch.images);
+	free(workers);
+	pthread_mutex_destroy(&batch.lock);
 
+	return batch.passed == batch.nimages ? 0 : 1;
 }
 
-// Checks if the addresses of the passed inode are valid.
-int validAddresses(struct dinode* inode){
-	// Get the blocks pointed to by the inode
-	uint* refBlocks = inode->addrs;
+// Reads the images of a batch: the regular files in a directory, in name order, or
+// the lines of a list file. Returns 0 if the batch can't be read.
+int loadBatch(const char* path, char*** images, unsigned long* nimages){
+	struct stat info;
+	if(stat(path, &info) < 0)
+		return 0;
 
-	// Iterate over the direct blocks
-	int i;
-	for(i = 0; i < NDIRECT + 1; i++){
-		// If the block is unallocated, don't worry about it
-		if(refBlocks[i] == 0)
-			continue;
-		
-		// If the block address is out of range, throw an error
-		if(refBlocks[i] < DATA_OFFSET || refBlocks[i] > SUPER_BLOCK->nblocks){
-			printf("ERROR: bad direct address in inode.\n");
+	unsigned long count = 0, cap = 64;
+	char** list = malloc(cap * sizeof(char*));
+	if(list == NULL)
+		return 0;
+
+	if(S_ISDIR(info.st_mode)){
+		struct dirent** entries;
+		int n = scandir(path, &entries, batchEntry, alphasort);
+		if(n < 0){
+			free(list);
 			return 0;
 		}
-	}
 
-	// Check if the indirect address is utilized
-	if(refBlocks[NDIRECT] != 0){
-		// If so, read the indirect block
-		struct block b;
-		bread(refBlocks[NDIRECT], &b);
-
-		// Get the address from the indirect block, and iterate through them
-		uint* indirect = (uint*)b.data;
-		for(i = 0; i < readLength(inode->size); i++){
-			// If block addresses are out of range, throw an error
-			if(indirect[i] < DATA_OFFSET || indirect[i] > SUPER_BLOCK->nblocks){
-				printf("ERROR: bad indirect address in inode.\n");
-				return 0;
+		int i;
+		for(i = 0; i < n; i++){
+			char* image = malloc(strlen(path) + strlen(entries[i]->d_name) + 2);
+			if(image != NULL)
+				sprintf(image, "%s/%s", path, entries[i]->d_name);
+
+			// Only regular files and devices hold images
+			if(image == NULL || stat(image, &info) < 0 || !(S_ISREG(info.st_mode) || S_ISBLK(info.st_mode))){
+				free(image);
+				continue;
 			}
+
+			if(!batchAdd(&list, &count, &cap, image))
+				break;
 		}
-	}
 
-	// Otheriwse, the test has succeeded, so we return 1.
-	return 1;
-}
+		for(i = 0; i < n; i++){
+			free(entries[i]);
+		}
+		free(entries);
+	} else{
+		FILE* file = fopen(path, "r");
+		if(file == NULL){
+			free(list);
+			return 0;
+		}
 
-// Checks if the blockIndex given is referenced by an inode somewhere
-int blockInInodes(int blockIndex){
-	// Iterate through the list of inodes
-	int i;
-	for(i = 0; i < SUPER_BLOCK->ninodes; i++){
-		// Only examine useable inodes
-		if(useableType(INODES[i].type)){
-			// Iterate through the direct addresses
-			uint* refBlocks = INODES[i].addrs;
-
-			int j;
-			for(j = 0; j < NDIRECT + 1; j++){
-				// If the blockIndex is referenced by a direct address,
-				// return success
-				if(refBlocks[j] == blockIndex){
-					return 1;
-				}
-			}
+		// One image per line. Blank lines are skipped.
+		char* line = NULL;
+		size_t length = 0;
+		ssize_t n;
+		while((n = getline(&line, &length, file)) != -1){
+			while(n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+				line[--n] = '\0';
+			if(n == 0)
+				continue;
 
-			// Check if the indirect block is utilized
-			if(refBlocks[NDIRECT] != 0){
-				// If so, read the indirect block
-				struct block b;
-				bread(refBlocks[NDIRECT], &b);
-
-				// Iterate through the indirect block
-				uint* indirect = (uint*)b.data;
-				for(j = 0; j < readLength(INODES[i].size); j++){
-					// If the blockIndex is referenced by the indirect address,
-					// return success
-					if(indirect[j] == blockIndex){
-						return 1;
-					}
-				}
-			}
+			if(!batchAdd(&list, &count, &cap, strdup(line)))
+				break;
 		}
+		free(line);
+		fclose(file);
 	}
 
-	// We have found no matches for the blockIndex given within any inode.
-	// Return failure
-	return 0;
+	*images = list;
+	*nimages = count;
+	return 1;
 }
 
-// Checks if the data blocks referenced by a given inode are set as
-// in-use within the bitmap
-int inodeInBitmap(struct dinode* inode){
-	// Lits of block indexes referenced by the inode
-	uint* refBlocks = inode->addrs;
+// Appends an image to a batch list, growing it as needed. Returns 0 if memory ran out,
+// in which case the batch is cut short.
+int batchAdd(char*** list, unsigned long* count, unsigned long* cap, char* image){
+	if(image == NULL)
+		return 0;
 
-	// Check the linked data blocks within the inode - all the directly linked blocks,
-	// and the single linked block at the end
-	int i;
-	for(i = 0; i < NDIRECT + 1; i++){
-		int bIndex = refBlocks[i];
-		// If the direct link hasn't been instantiated yet, check
-		// the next one
-		if(bIndex == 0)
-			continue;
-		
-		// Block index is negative when it is writing
-		// sequential data from higher blocks to lower blocks.
-		// Realign the index to positive.
-		if(bIndex < 0)
-			bIndex = bIndex * -1;
-		
-		// If the current directly linked block isn't in use in the bitmap, but it's referenced
-		// by the inode, return false
-		if(!blockInUse(refBlocks[i]))
+	if(*count == *cap){
+		char** grown = realloc(*list, *cap * 2 * sizeof(char*));
+		if(grown == NULL){
+			free(image);
 			return 0;
-	}
-
-	// Check indirectly linked data blocks referenced at the end, if they exist
-	if(refBlocks[NDIRECT] != 0){
-		// Read the block which stores the indirect links
-		struct block b;
-		bread(refBlocks[NDIRECT], &b);
-		
-		// Iterate through the list of blocks stored in the indirect block
-		uint* indirect = (uint*)b.data;
-
-		// Figure out how many extra blocks were needed to store the file
-		for(i = 0; i < readLength(inode->size); i++){
-			// Get the current block index from the indirect block
-			int bIndex = indirect[i];
-			
-			// Check if its used by the inode
-			if(bIndex == 0)
-				continue;
-			
-			// If the current indirectly linked blocked isn't in use in the bitmap, but its
-			// referenced by the inode, return false
-			if(!blockInUse(bIndex))
-				return 0;
 		}
+		*list = grown;
+		*cap *= 2;
 	}
 
-	// The blocks referenced by the inodes and the bitmap match up - return true;
+	(*list)[(*count)++] = image;
 	return 1;
 }
 
-// Returns the number of reads to perform on an indirect block, based on the file size given
-int readLength(int fileSize){
-	// Subtract the number of used space for direct blocks from the total filesize,
-	// then divide by the total block size
-	int readLength = (fileSize - (NDIRECT * BLOCK_SIZE)) / BLOCK_SIZE;
+// Skips hidden entries and state files when scanning a batch directory
+int batchEntry(const struct dirent* entry){
+	return imageName(entry->d_name);
+}
 
-	// Account for off by one errors
-	readLength += ((fileSize - (NDIRECT * BLOCK_SIZE)) % BLOCK_SIZE) == 0 ? 0 : 1;
-	return readLength;
+// Returns 1 if a directory entry may hold an image: it isn't hidden, or a state file,
+// written or half written
+int imageName(const char* name){
+	return name[0] != '.' && strstr(name, STATE_SUFFIX) == NULL;
 }
 
-// Examines if the block at block index is marked as "in use" by the bitmap
-int blockInUse(int blockIndex){
-	// If we're trying to access an invalid block, return false
-	if(blockIndex < 0)
-		return 0;
+// Checks images until there are none left to take
+void* batchWorker(void* arg){
+	struct batch* batch = arg;
 
-	if(blockIndex > SUPER_BLOCK->nblocks - 1)
-		return 0;
-	
-	// If the bit is '0' at the index, then the block is not in use
-	if(!blockBit(blockIndex))
-		return 0;
+	unsigned long i;
+	while((i = atomic_fetch_add(&batch->next, 1)) < batch->nimages){
+		checkImage(batch, batch->images[i]);
+	}
 
-	// Otherwise, assume the block is in use, and return true
-	return 1;
+	return NULL;
 }
 
-// Checks if the type supplied is usable in the application
-// xv6 file systems only support 3 explicit serial types, so we only
-// need to check within a range
-int useableType(int type){
-	if(type > 0 && type < 4)
-		return 1;
+// Checks one image of a batch and prints its result line
+void checkImage(struct batch* batch, const char* image){
+	struct tally tally = { 0, 0 };
+	struct xcheckGeometry geometry;
+	memset(&geometry, 0, sizeof(geometry));
+
+	struct xcheckOptions options = batch->options;
+	char* sidecar = NULL;
+	if(batch->state){
+		sidecar = statePath(image);
+		options.state = sidecar;
+	}
 
-	return 0;
+	struct xcheck* xc = (sidecar != NULL || !batch->state) ? xcheckNew(&options) : NULL;
+	int result = xc != NULL ? xcheckOpen(xc, image) : XCHECK_ENOMEM;
+	if(result == XCHECK_OK){
+		result = xcheckRun(xc, noteFinding, &tally);
+		xcheckGeometry(xc, &geometry);
+	}
+
+	pthread_mutex_lock(&batch->lock);
+	printVerdict(image, xc, result, &tally, batch->options.all, "");
+	if(result < 0)
+		batch->unchecked++;
+	else if(result == XCHECK_FOUND)
+		batch->failed++;
+	else
+		batch->passed++;
+	batch->bytes += geometry.imageBytes;
+
+	// Results stream out as they finish, even into a pipe
+	fflush(stdout);
+	pthread_mutex_unlock(&batch->lock);
+
+	if(xc != NULL)
+		xcheckFree(xc);
+	free(sidecar);
 }
 
-// Checks if the inode given to it is valid
-int validInode(struct dinode* inode){
-	// If the type of the inode isn't recognized as immediately useable,
-	// examine it more
-	if(!useableType(inode->type)){
-		// If the inode is just unallocated, return true
-		if(inode->type == T_UNALLOC)
-			return 1;
+// Counts the findings of a batch image, keeping the first
+void noteFinding(void* arg, const struct xcheckFinding* finding){
+	struct tally* tally = arg;
+	if(tally->found++ == 0)
+		tally->rule = finding->rule;
+}
 
-		// Otherwise, return false
-		return 0;
-	}
-	
-	// If the type is immediately useable, return true;
-	return 1;
+// Prints the result line of an image, followed by note
+void printVerdict(const char* image, struct xcheck* xc, int result, const struct tally* tally, int all, const char* note){
+	if(result < 0)
+		printf("%s: ERROR: %s%s\n", image, xc != NULL ? xcheckError(xc) : "could not allocate checker", note);
+	else if(result == XCHECK_FOUND && all)
+		printf("%s: %lu errors found.%s\n", image, xcheckFindings(xc), note);
+	else if(result == XCHECK_FOUND)
+		printf("%s: ERROR: %s%s\n", image, xcheckRuleMessage(tally->rule), note);
+	else
+		printf("%s: Check complete!%s\n", image, note);
 }
 
-// Gets the bit from the bitmap at the given index
-int blockBit(int index){
-	// If we the desired block index is unaccesible, return 0
-	if(index < 1 || index > SUPER_BLOCK->nblocks)
-		return 0;
+// ***
+// *
+// *   Watch functions
+// *
+// ***
 
-	// Bit we will return
-	int bit;
+// Checks every image in a directory, then checks each again whenever it changes, once
+// its writes have paused for debounce milliseconds. Each image's checker stays open
+// between checks. A line is printed per check, giving how long after the image's first
+// change the verdict came. Runs until interrupted, then returns the exit status: 0
+// unless the directory couldn't be watched.
+int runWatch(const char* dir, const struct xcheckOptions* options, int state, int debounce){
+	struct watch watch;
+	memset(&watch, 0, sizeof(watch));
+	watch.dir = dir;
+	watch.options = *options;
+	watch.state = state;
+	watch.debounce = debounce;
+
+	// Watch before the first pass, so no change made during it is missed
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(fd < 0 || inotify_add_watch(fd, dir, IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO |
+	   IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR) < 0){
+		fprintf(stderr, "ERROR: could not watch %s\n", dir);
+		if(fd >= 0)
+			close(fd);
+		return 1;
+	}
 
-	// Get the byte the bit is in
-	int byte = index / 8;
+	// Stop cleanly when interrupted. Without SA_RESTART, poll returns at once.
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = stopWatch;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
 
-	// Get the position within the byte the index references
-	int bitPos = index % 8;
-	
-	// Shift and mask the bits to get the one we want
-	char raw = BMAP[byte];
-	raw = raw >> bitPos;
-	raw = raw & 0x1;
+	// Every image starts out due for a check
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	// Convert and return our bit in a more useable state
-	bit = (int)raw;
-	return bit;
-}
+	struct dirent** entries;
+	int n = scandir(dir, &entries, batchEntry, alphasort);
+	int i;
+	for(i = 0; i < n; i++){
+		struct watched* image = watchFind(&watch, entries[i]->d_name, 1);
+		if(image != NULL){
+			image->dirty = 1;
+			image->changed = now;
+		}
+		free(entries[i]);
+	}
+	if(n >= 0)
+		free(entries);
+
+	// An image which turns out not to be one is dropped, and the next takes its place
+	unsigned long j;
+	for(j = 0; j < watch.nimages;){
+		if(watchCheck(&watch, &watch.images[j], NULL))
+			j++;
+	}
 
-// Reads the block data at position index into a block structure
-void bread(int index, struct block* b){
-	b->data = &FS_ADDR[index * BLOCK_SIZE];
-}
+	// Gather changes until some image has been left alone long enough to check
+	char buf[sizeof(struct inotify_event) * 64 + NAME_MAX + 1] __attribute__((aligned(__alignof__(struct inotify_event))));
+	int watching = 1;
+	while(watching && !STOP_WATCH){
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		int ready = poll(&pfd, 1, watchNext(&watch, &now));
+		if(ready < 0 && errno != EINTR){
+			fprintf(stderr, "ERROR: could not wait for changes to %s\n", dir);
+			break;
+		}
 
-// Init prerequisite data and structures before
-// filesystem analysis begins
-void init(char* fileName){
-	// Get the file descriptor to the file system
-	FSFD = open(fileName, O_RDONLY);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ssize_t length;
+		while(ready > 0 && (length = read(fd, buf, sizeof(buf))) > 0){
+			char* at;
+			for(at = buf; at < buf + length; at += sizeof(struct inotify_event) + ((struct inotify_event*)at)->len){
+				struct inotify_event* event = (struct inotify_event*)at;
+				if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)){
+					fprintf(stderr, "xcheck: %s is gone, no longer watching\n", dir);
+					watching = 0;
+				} else{
+					watchEvent(&watch, event, &now);
+				}
+			}
+		}
 
-	// If there was an error, output a message and exit
-	if(FSFD < 0){
-		fprintf(stderr, "ERROR: image not found\n");
-		exit(1);
+		// Check the images whose writes have settled
+		for(j = 0; j < watch.nimages;){
+			struct watched* image = &watch.images[j];
+			if(!image->dirty || (elapsedMs(&image->written, &now) < watch.debounce &&
+			   elapsedMs(&image->changed, &now) < (double)watch.debounce * DEBOUNCE_LIMIT) ||
+			   watchCheck(&watch, image, &now))
+				j++;
+		}
 	}
 
-	// Get info on the file system
-	struct stat finfo;
-	if(fstat(FSFD, &finfo) < 0){
-		fprintf(stderr, "ERROR: could not load image statistics\n");
-		exit(1);
+	while(watch.nimages > 0)
+		watchDrop(&watch, &watch.images[watch.nimages - 1]);
+	free(watch.images);
+	close(fd);
+
+	return 0;
+}
+
+// Notes a change to the watched directory. Images written in place are checked again
+// through their open checker; those created or moved in are opened anew. An event
+// queue overflow may have lost changes to any image, so every one is reopened.
+void watchEvent(struct watch* watch, const struct inotify_event* event, struct timespec* now){
+	if(event->mask & IN_Q_OVERFLOW){
+		unsigned long i;
+		for(i = 0; i < watch->nimages; i++){
+			watch->images[i].replaced = 1;
+			if(!watch->images[i].dirty)
+				watch->images[i].changed = *now;
+			watch->images[i].dirty = 1;
+			watch->images[i].written = *now;
+		}
+		return;
 	}
 
-	// Create an address mapping to the entire file system
-	int fsize = finfo.st_size;
-	FS_ADDR = mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, FSFD, 0);
-	if(FS_ADDR == MAP_FAILED){
-		fprintf(stderr, "Error mapping file system into memory!");
+	if(event->len == 0 || !imageName(event->name) || (event->mask & IN_ISDIR))
+		return;
+
+	if(event->mask & (IN_DELETE | IN_MOVED_FROM)){
+		// An image gone before its first check goes unmentioned
+		struct watched* image = watchFind(watch, event->name, 0);
+		if(image != NULL){
+			if(!image->replaced || image->xc != NULL){
+				printf("%s: removed\n", image->path);
+				fflush(stdout);
+			}
+			watchDrop(watch, image);
+		}
+		return;
 	}
 
-	// Read the super block
-	struct block b;
-	bread(1, &b);
-	SUPER_BLOCK = (struct superblock*) b.data;
+	struct watched* image = watchFind(watch, event->name, 1);
+	if(image == NULL)
+		return;
 
-	// Read the inodes block
-	bread(2, &b);
-	INODES = (struct dinode*)b.data;
+	if(event->mask & (IN_CREATE | IN_MOVED_TO))
+		image->replaced = 1;
+	if(!image->dirty)
+		image->changed = *now;
+	image->dirty = 1;
+	image->written = *now;
+}
 
-	// Read the root directory
-	bread(INODES[ROOT_INO].addrs[0], &b);
-	ROOT_DIR = (struct dirent*)b.data;
+// Returns the image with the given name, adding it if add is set and it isn't there.
+// Returns NULL if it isn't there and can't be added.
+struct watched* watchFind(struct watch* watch, const char* name, int add){
+	struct watched key = { .name = (char*)name };
+	struct watched* image = NULL;
+	if(watch->nimages > 0)
+		image = bsearch(&key, watch->images, watch->nimages, sizeof(struct watched), compareWatched);
+	if(image != NULL || !add)
+		return image;
+
+	if(watch->nimages == watch->cap){
+		unsigned long cap = watch->cap == 0 ? 16 : watch->cap * 2;
+		struct watched* grown = realloc(watch->images, cap * sizeof(struct watched));
+		if(grown == NULL)
+			return NULL;
+		watch->images = grown;
+		watch->cap = cap;
+	}
 
-	// Read the used data block bitmap
-	int bmBlock = inode2Block(SUPER_BLOCK->ninodes) + 1;
-	bread(bmBlock, &b);
-	BMAP = b.data;
+	// Keep the images in name order
+	unsigned long at = 0;
+	while(at < watch->nimages && strcmp(watch->images[at].name, name) < 0)
+		at++;
+
+	struct watched added;
+	memset(&added, 0, sizeof(added));
+	added.name = strdup(name);
+	added.path = malloc(strlen(watch->dir) + strlen(name) + 2);
+	if(added.path != NULL)
+		sprintf(added.path, "%s/%s", watch->dir, name);
+	if(added.path != NULL && watch->state)
+		added.sidecar = statePath(added.path);
+	if(added.name == NULL || added.path == NULL || (watch->state && added.sidecar == NULL)){
+		free(added.name);
+		free(added.path);
+		free(added.sidecar);
+		return NULL;
+	}
+	added.replaced = 1;
 
-	// Get the offset for data blocks
-	DATA_OFFSET = bmBlock + 1;	
+	memmove(&watch->images[at + 1], &watch->images[at], (watch->nimages - at) * sizeof(struct watched));
+	watch->images[at] = added;
+	watch->nimages++;
+	return &watch->images[at];
 }
 
-// Returns the block which an inode at inodeIndex is located in
-int inode2Block(int inodeIndex){
-	return (inodeIndex / INODE_PB) + 2;
+// Closes an image and stops watching it
+void watchDrop(struct watch* watch, struct watched* image){
+	if(image->xc != NULL)
+		xcheckFree(image->xc);
+	free(image->name);
+	free(image->path);
+	free(image->sidecar);
+
+	unsigned long at = image - watch->images;
+	memmove(image, image + 1, (watch->nimages - at - 1) * sizeof(struct watched));
+	watch->nimages--;
 }
 
-// ***
-// *
-// *   Debug Functions
-// *
-// ***
+// Checks an image and prints its result line, with how long after its first change
+// the verdict came unless now is NULL. Its checker stays open to check the next change
+// with; one that fails to read the image is closed, and the image opened anew next time.
+// Returns 0 if the image is no longer there to check, and has been dropped.
+int watchCheck(struct watch* watch, struct watched* image, struct timespec* now){
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Only regular files and devices hold images. Anything else is forgotten.
+	struct stat info;
+	if(stat(image->path, &info) < 0 || !(S_ISREG(info.st_mode) || S_ISBLK(info.st_mode))){
+		watchDrop(watch, image);
+		return 0;
+	}
 
-// Dumps a directory's data to the command line
-// Indirect addressing still buggy
-void debugDumpDir(struct dinode* inode){
-	uint* refBlocks = inode->addrs;
+	int result;
+	if(image->xc != NULL && !image->replaced){
+		result = xcheckRefresh(image->xc);
+	} else{
+		if(image->xc != NULL)
+			xcheckFree(image->xc);
+
+		struct xcheckOptions options = watch->options;
+		options.state = image->sidecar;
+		image->xc = xcheckNew(&options);
+		result = image->xc != NULL ? xcheckOpen(image->xc, image->path) : XCHECK_ENOMEM;
+	}
 
-	printf("----- DIR DATA -----\n");
+	struct tally tally = { 0, 0 };
+	if(result == XCHECK_OK)
+		result = xcheckRun(image->xc, noteFinding, &tally);
 
-	int i, j, directReadLength, size = inode->size;
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
 
-	for(i = 0; i < NDIRECT + 1; i++){
-		if(refBlocks[i] == 0)
-			continue;
-		
-		struct block b;
-		bread(refBlocks[i], &b);
-		
-		struct dirent* dirData = (struct dirent*)b.data;
-
-		if(size / BLOCK_SIZE > 0){
-			directReadLength = BLOCK_SIZE / sizeof(struct dirent);
-			size -= BLOCK_SIZE;
-		} else{
-			directReadLength = size / sizeof(struct dirent);
-		}
-		
-		for(j = 0; j < directReadLength; j++){
-			if(dirData[j].inum == 0)
-				continue;
+	char note[96] = "";
+	if(now != NULL)
+		snprintf(note, sizeof(note), " (%.1f ms after the change, %.1f ms to check)",
+			elapsedMs(&image->changed, &end), elapsedMs(&start, &end));
+	printVerdict(image->path, image->xc, result, &tally, watch->options.all, note);
+	fflush(stdout);
 
-			printf("%u - '%s'\n", dirData[j].inum, dirData[j].name);
-		}
+	if(result < 0 && image->xc != NULL){
+		xcheckFree(image->xc);
+		image->xc = NULL;
 	}
+	image->dirty = 0;
+	image->replaced = 0;
+	return 1;
+}
 
-	if(refBlocks[NDIRECT] != 0){
-		struct block b;
-		bread(refBlocks[NDIRECT], &b);
-
-		uint* indirect = (uint*)b.data;
-
-		for(i = 0; i < readLength(inode->size) / sizeof(struct dirent); i++){
-			bread(indirect[i], &b);
-
-			struct dirent* dirData = (struct dirent*)b.data;
+// Returns the milliseconds until the next image is due for a check, or -1 to wait for
+// the next change if none are
+int watchNext(struct watch* watch, struct timespec* now){
+	double wait = -1;
 
-			for(j = 0; j < BLOCK_SIZE; j++){
-				if(dirData[j].inum == 0)
-					continue;
+	unsigned long i;
+	for(i = 0; i < watch->nimages; i++){
+		struct watched* image = &watch->images[i];
+		if(!image->dirty)
+			continue;
 
-				printf("%u - '%s'\n", dirData[j].inum, dirData[j].name);
-			}
-		}
+		double settled = watch->debounce - elapsedMs(&image->written, now);
+		double limit = (double)watch->debounce * DEBOUNCE_LIMIT - elapsedMs(&image->changed, now);
+		double due = settled < limit ? settled : limit;
+		if(due < 0)
+			due = 0;
+		if(wait < 0 || due < wait)
+			wait = due;
 	}
+
+	// Round up, so the image is due when poll returns
+	return wait < 0 ? -1 : (int)wait + 1;
 }
 
-// Prints the individuals bits of a byte to the console
-void debugPrintByte(char byte){
-	int i;
-	for(i = 0; i < 8; i++){
-		printf("%d", ((byte >> (7 - i)) & 0x1));
-	}
-	printf("\n");
+// Orders watched images by name
+int compareWatched(const void* a, const void* b){
+	return strcmp(((const struct watched*)a)->name, ((const struct watched*)b)->name);
 }
 
-// Dumps a block's data to the command line, with MAX to control 
-// amount of data dumped                                         
-void debugDumpBlock(struct block b, int MAX){
-	int i;
-	for(i = 0; i < MAX; i++){
-		printf("[%d]\n", b.data[i]);
-	}
+// Returns the milliseconds from one time to another
+double elapsedMs(const struct timespec* from, const struct timespec* to){
+	return (to->tv_sec - from->tv_sec) * 1e3 + (to->tv_nsec - from->tv_nsec) / 1e6;
 }
 
-void cleanup(){
-	//free(INODES);
-	//free(SUPER_BLOCK);
-	close(FSFD);
+// Stops the watch once the current check is done
+void stopWatch(int signum){
+	(void)signum;
+	STOP_WATCH = 1;
 }
@@ -0,0 +1,151 @@
+#ifndef _XCHECK_H_
+#define _XCHECK_H_
+
+// Checks xv6 file system images for consistency. Each image is checked through its
+// own checker context, so any number of images may be checked at once, from as many
+// threads. Nothing is printed; what is found is passed to a sink.
+
+// Results of xcheckOpen and xcheckRun. Errors are negative.
+#define XCHECK_OK 0
+#define XCHECK_FOUND 1         // The image breaks some rule
+#define XCHECK_EOPEN -1        // The image can't be opened
+#define XCHECK_EFORMAT -2      // The image is too small for what it describes
+#define XCHECK_ENOMEM -3       // Memory ran out
+#define XCHECK_EREAD -4        // The image couldn't be read
+
+// Rules broken by findings, in the order they are checked
+#define XCHECK_RULE_BAD_INODE 0
+#define XCHECK_RULE_BAD_DIRECT 1
+#define XCHECK_RULE_BAD_INDIRECT 2
+#define XCHECK_RULE_BAD_ROOT 3
+#define XCHECK_RULE_BAD_DIRECTORY 4
+#define XCHECK_RULE_MARKED_FREE 5
+#define XCHECK_RULE_MARKED_USED 6
+#define XCHECK_RULE_DUP_DIRECT 7
+#define XCHECK_RULE_DUP_INDIRECT 8
+#define XCHECK_RULE_UNREFERENCED 9
+#define XCHECK_RULE_REFERENCED_FREE 10
+#define XCHECK_RULE_BAD_REFCOUNT 11
+#define XCHECK_RULE_DIR_ONCE 12
+#define XCHECK_RULE_PARENT_MISMATCH 13
+#define XCHECK_RULE_INACCESSIBLE 14
+#define XCHECK_RULE_BITMAP_COUNT 15
+#define XCHECK_RULE_BAD_NAME 16
+#define XCHECK_RULE_DUP_NAME 17
+#define XCHECK_RULES 18
+
+// How thoroughly an image is checked
+#define XCHECK_LEVEL_QUICK 1       // Inode types, the root inode, and a count of the bitmap
+#define XCHECK_LEVEL_STANDARD 2    // Every rule of the inodes, their addresses and the bitmap
+#define XCHECK_LEVEL_DEEP 3        // The standard rules and the directory tree
+
+// How an image is checked. Zeroed options check deep with one thread from a memory
+// mapping, stop at the first rule broken, keep no state between checks, and find the
+// layout from the image. Under a memory budget the blocks are checked a window at a
+// time, with the same results.
+struct xcheckOptions {
+	int threads;               // Threads sweeping the inodes and walking the tree
+	const char* source;        // Block source: mmap, pread, direct or uring
+	unsigned int queueDepth;   // Reads the uring source keeps in flight
+	int all;                   // Check every rule to completion, rather than stop at the first broken
+	unsigned long maxFindings; // Findings kept when checking every rule; the rest are only counted
+	int stats;                 // Time each stage, and count what it does
+	const char* state;         // File remembering the image's digests and verdict, or NULL
+	int full;                  // Check in full even if the state shows nothing changed
+	int level;                 // XCHECK_LEVEL_*, or 0 for deep
+	unsigned long memoryBudget; // Bytes the block maps may take, or 0 for no limit
+	const char* layout;        // Block size and addressing of the image, or NULL to find them
+};
+
+// A rule broken in the image. The inodes or block are 0 where they don't apply.
+struct xcheckFinding {
+	unsigned int rule;
+	unsigned int inum;
+	unsigned int block;
+	unsigned int firstInum;    // For duplicates, the inode holding the first reference
+};
+
+// A timed stage of the check
+struct xcheckStage {
+	const char* name;
+	double wallMs;
+	double cpuMs;              // CPU time of the whole process
+	unsigned long inodes;      // Inodes visited
+	unsigned long blocks;      // Blocks read
+	long minorFaults;          // Faults of the whole process
+	long majorFaults;
+};
+
+// Geometry of an open image
+struct xcheckGeometry {
+	const char* layout;        // Name of the image's layout
+	unsigned int blockSize;    // Bytes in each block
+	unsigned int size;         // Blocks in the image
+	unsigned int nblocks;      // Data blocks
+	unsigned int ninodes;
+	unsigned int bitmapBlocks;
+	unsigned int dataOffset;   // First data block, after the bitmap
+	unsigned int inodeStart;   // First block of the inode table
+	unsigned int logBlocks;    // Blocks in the log, or 0 for the older layout without one
+	unsigned int logReplayed;  // Blocks the log replaces with its committed copies
+	unsigned long mapBytes;    // Bytes in each block map a sweep worker holds
+	unsigned int windows;      // Windows of blocks swept, one at a time
+	unsigned int windowBlocks; // Blocks in each window
+	unsigned long imageBytes;  // Bytes in the image file or device
+};
+
+// Receives the findings of a check, in the order the rules are checked
+typedef void (*xcheckSink)(void* arg, const struct xcheckFinding* finding);
+
+// Creates a checker context, or returns NULL if the options name no known source,
+// layout or level, or memory runs out
+struct xcheck* xcheckNew(const struct xcheckOptions* options);
+
+// Opens an image for checking, returning XCHECK_OK or an error
+int xcheckOpen(struct xcheck* xc, const char* image);
+
+// Reads the open image again after it changed in place, keeping the file and memory
+// the last check held. Returns XCHECK_OK or an error; checking it then is up to
+// xcheckRun.
+int xcheckRefresh(struct xcheck* xc);
+
+// Checks the open image, passing what it finds to sink. Returns XCHECK_OK if the image
+// is consistent, XCHECK_FOUND if it isn't, or an error.
+int xcheckRun(struct xcheck* xc, xcheckSink sink, void* arg);
+
+// Closes the image and frees the context
+void xcheckFree(struct xcheck* xc);
+
+// Returns the number of findings, including those past the cap
+unsigned long xcheckFindings(struct xcheck* xc);
+
+// Returns a description of the last error
+const char* xcheckError(struct xcheck* xc);
+
+// Returns the name of the block source in use. A source the kernel can't support
+// falls back to another.
+const char* xcheckSource(struct xcheck* xc);
+
+// Points stages at the stages timed so far, returning how many there are
+int xcheckStages(struct xcheck* xc, const struct xcheckStage** stages);
+
+// Fills in the geometry of the open image
+void xcheckGeometry(struct xcheck* xc, struct xcheckGeometry* geometry);
+
+// Returns the number of regions of the image digested for the state file, and sets
+// changed to how many differed from it. The last verdict is reused when none did.
+unsigned int xcheckRegions(struct xcheck* xc, unsigned int* changed);
+
+// Returns 1 if there is a block source with the given name, 0 otherwise
+int xcheckHasSource(const char* name);
+
+// Returns 1 if there is a layout with the given name, 0 otherwise. Layouts are named by
+// block size, 512, 1k or 4k, with a -double suffix for those whose last inode address
+// is a doubly indirect block.
+int xcheckHasLayout(const char* name);
+
+// Return a short identifier for a rule, and the message printed when it is broken
+const char* xcheckRuleId(unsigned int rule);
+const char* xcheckRuleMessage(unsigned int rule);
+
+#endif // _XCHECK_H_